@@ -6,6 +6,7 @@
 #include <inc/assert.h>
 
 #define SECTSIZE 512                  // bytes per disk sector
+#define IDE_MAX_SECTORS 65536         // per command [by the 48-bit LBA commands]
 #define BLKSECTS (BLKSIZE / SECTSIZE) // sectors per block
 
 /* Disk block n, when in memory, is mapped into the file system
@@ -20,4 +21,9 @@
 // void	ide_set_disk(int diskno);
 int ide_read(uint32 secno, void *dst, uint32 nsecs);
 int ide_write(uint32 secno, const void *src, uint32 nsecs);
+void ide_enable_interrupts(bool enable);
+void ide_start_command(uint32 secno, uint32 nsecs, uint8 command);
+int ide_start_read(uint32 secno, uint32 nsecs);
+int ide_end_command(void);
+int ide_read_sector(void *dst);
 #endif // !DISK_H
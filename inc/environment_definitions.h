@@ -46,6 +46,7 @@ unsigned int _ModifiedBufferLength;
 #define ENV_NEW 4
 #define ENV_EXIT 5
 #define ENV_UNKNOWN 6
+#define ENV_SUSPENDED 7 // swapped out by the load control [see kern/load_control.c]
 
 uint32 old_pf_counter;
 // uint32 mydblchk;
@@ -58,6 +59,8 @@ struct WorkingSetElement
 	unsigned int time_stamp;
 };
 
+struct ARC_State;
+
 struct Env
 {
 	struct Trapframe env_tf; // Saved registers
@@ -90,6 +93,19 @@ struct Env
 #else
 	struct WorkingSetElement *ptr_pageWorkingSet;
 #endif
+	// page working set index [kernel only, kept in sync by env_page_ws_set_entry()/env_page_ws_clear_entry()]
+	uint32 page_WS_size;		 // number of non-empty entries
+	uint32 page_WS_num_of_spare_entries; // entries of the array out of the WS quota [see env_page_ws_get_quota()]
+	uint32 *__pws_free_bitmap;	 // bit i is set if entry i is empty
+	uint32 *__pws_free_summary;	 // bit j is set if word j of __pws_free_bitmap is not zero
+	int32 *__pws_hash_buckets;	 // VA hash -> first entry of its chain (-1 if none)
+	int32 *__pws_hash_next;		 // next entry in the same hash chain
+	uint32 __pws_hash_mask;
+	int32 *__pws_fifo_next;		 // load order of the non-empty entries (oldest first)
+	int32 *__pws_fifo_prev;
+	int32 __pws_fifo_head;
+	int32 __pws_fifo_tail;
+	struct ARC_State *__pws_arc; // ARC lists of the WS [created at the first ARC replacement]
 
 	// table working set management
 	struct WorkingSetElement __ptr_tws[__TWS_MAX_SIZE];
@@ -106,6 +122,29 @@ struct Env
 	uint32 nModifiedPages;
 	uint32 nNotModifiedPages;
 
+	// ARC replacement: referenced pages found by the clock hands and faults on pages of the ghost lists
+	uint32 nARCHits;
+	uint32 nARCGhostHitsB1;
+	uint32 nARCGhostHitsB2;
+
+	// readahead: detector of sequential/strided page faults [see kern/readahead.c]
+	uint32 raLastFaultVA;
+	int32 raStride;			 // pages between the faults of the current stream (0 = no stream)
+	uint32 raWindow;		 // pages to read ahead at the next fault of the stream
+	uint32 raLastNumOfPages; // pages read ahead at the last fault
+	uint32 raNumOfPages;	 // pages read ahead so far
+	uint32 raNumOfHits;		 // pages read ahead that were used by the next fault
+
+	// page fault frequency: dynamic sizing of the page WS [see kern/pff.c]
+	uint32 pffLastPageFaultsCounter; // pageFaultsCounter at the end of the last quantum
+	uint32 pffNumOfQuietQuanta;		 // consecutive quanta with few faults
+	uint32 pffNumOfGrows;
+	uint32 pffNumOfShrinks;
+
+	// load control
+	uint32 lcLastPageFaultsCounter; // pageFaultsCounter at the last clock tick it was running
+	uint32 nSwapOuts;
+
 	// Program name (to print it via USER.cprintf in multitasking)
 	char prog_name[PROGNAMELEN];
 
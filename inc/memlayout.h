@@ -148,6 +148,14 @@
 
 // 2016
 #define KERNEL_HEAP_START 0xF6000000
+// One page (below the kernel heap) used by the kernel to temporarily map a frame to zero it
+#define KERNEL_ZEROING_WINDOW (KERNEL_HEAP_START - PAGE_SIZE)
+// Pages (below the zeroing window) used by the kernel to temporarily map a run of frames to read/write them from/to
+// the page file by one disk command
+#define KERNEL_DISK_WINDOW_PAGES 256
+#define KERNEL_DISK_WINDOW (KERNEL_ZEROING_WINDOW - KERNEL_DISK_WINDOW_PAGES * PAGE_SIZE)
+// One page (below the disk window) used by the disk interrupt handler to map the frame it reads into
+#define KERNEL_DISK_IO_WINDOW (KERNEL_DISK_WINDOW - PAGE_SIZE)
 #define KERNEL_HEAP_MAX 0xFFFFF000
 
 #define USER_HEAP_START 0x80000000
@@ -206,6 +214,9 @@ struct Frame_Info
 	uint32 va;
 	struct Env *environment;
 	unsigned char isBuffered;
+	uint32 kheap_va; // kernel heap VA mapped to this frame (0 if it's not a kernel heap frame)
+	unsigned char isBuddyFree; // 1 if this frame is the first frame of a free buddy block
+	unsigned char buddyOrder;  // order of the free buddy block (valid only if isBuddyFree)
 };
 
 #endif /* !__ASSEMBLER__ */
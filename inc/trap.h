@@ -26,6 +26,7 @@
 
 // IRQs
 #define IRQ0_Clock 32 // Clock IRQ
+#define IRQ14_Disk 46 // Primary IDE channel IRQ
 
 // These are arbitrarily chosen, but with care not to overlap
 // processor defined exceptions or interrupt vectors.
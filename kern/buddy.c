@@ -0,0 +1,122 @@
+#include <inc/memlayout.h>
+#include <inc/stdio.h>
+#include <inc/assert.h>
+#include <kern/buddy.h>
+#include <kern/memory_manager.h>
+
+struct Linked_List buddy_free_lists[BUDDY_MAX_ORDER + 1];
+
+uint32 buddyNumOfFreeFrames;
+uint32 buddyNumOfSplits;
+uint32 buddyNumOfMerges;
+uint32 buddyNumOfFailures[BUDDY_MAX_ORDER + 1]; // failed allocations per order
+
+void buddy_initialize()
+{
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++)
+	{
+		LIST_INIT(&buddy_free_lists[order]);
+		buddyNumOfFailures[order] = 0;
+	}
+	buddyNumOfFreeFrames = 0;
+	buddyNumOfSplits = 0;
+	buddyNumOfMerges = 0;
+}
+
+static void buddy_insert(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	ptr_frame_info->isBuddyFree = 1;
+	ptr_frame_info->buddyOrder = order;
+	LIST_INSERT_HEAD(&buddy_free_lists[order], ptr_frame_info);
+}
+
+static void buddy_remove(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	LIST_REMOVE(&buddy_free_lists[order], ptr_frame_info);
+	ptr_frame_info->isBuddyFree = 0;
+	ptr_frame_info->buddyOrder = 0;
+}
+
+// Remove a free block of 2^order frames from the buddy lists (splitting a larger block if needed).
+// Return its first frame, or NULL if there is no free block that is large enough.
+// The frames of the block are NOT initialized
+struct Frame_Info *buddy_allocate_block(uint32 order)
+{
+	if (order > BUDDY_MAX_ORDER)
+		return NULL;
+
+	// Find the smallest order that has a free block
+	uint32 blockOrder = order;
+	while (blockOrder <= BUDDY_MAX_ORDER && LIST_EMPTY(&buddy_free_lists[blockOrder]))
+		blockOrder++;
+	if (blockOrder > BUDDY_MAX_ORDER)
+	{
+		buddyNumOfFailures[order]++;
+		return NULL;
+	}
+
+	struct Frame_Info *ptr_block = LIST_FIRST(&buddy_free_lists[blockOrder]);
+	buddy_remove(ptr_block, blockOrder);
+
+	// Split it till it has the required order: the upper halves go back to the lists
+	while (blockOrder > order)
+	{
+		blockOrder--;
+		buddy_insert(ptr_block + (1 << blockOrder), blockOrder);
+		buddyNumOfSplits++;
+	}
+	buddyNumOfFreeFrames -= (1 << order);
+	return ptr_block;
+}
+
+// Return a block of 2^order frames to the buddy lists, merging it with its free buddies
+void buddy_free_block(struct Frame_Info *ptr_frame_info, uint32 order)
+{
+	uint32 frameNumber = to_frame_number(ptr_frame_info);
+	assert((frameNumber & ((1 << order) - 1)) == 0);
+	buddyNumOfFreeFrames += (1 << order);
+
+	while (order < BUDDY_MAX_ORDER)
+	{
+		uint32 buddyNumber = frameNumber ^ (1 << order);
+		if (buddyNumber + (1 << order) > number_of_frames)
+			break;
+		struct Frame_Info *ptr_buddy = &frames_info[buddyNumber];
+		if (!ptr_buddy->isBuddyFree || ptr_buddy->buddyOrder != order)
+			break;
+		buddy_remove(ptr_buddy, order);
+		buddyNumOfMerges++;
+		frameNumber &= ~(1 << order);
+		order++;
+	}
+	buddy_insert(&frames_info[frameNumber], order);
+}
+
+uint32 buddy_num_of_free_frames()
+{
+	return buddyNumOfFreeFrames;
+}
+
+void buddy_print_statistics()
+{
+	int largestOrder = -1;
+	cprintf("Free blocks per order:");
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++)
+	{
+		cprintf(" %d:%d", order, LIST_SIZE(&buddy_free_lists[order]));
+		if (LIST_SIZE(&buddy_free_lists[order]) > 0)
+			largestOrder = order;
+	}
+	cprintf("\n");
+	if (largestOrder >= 0)
+	{
+		// fragmentation = % of the free frames that can't serve a request of the largest order
+		uint32 numOfFramesInMaxBlocks = LIST_SIZE(&buddy_free_lists[BUDDY_MAX_ORDER]) << BUDDY_MAX_ORDER;
+		cprintf("Largest free block = %d frames, external fragmentation = %d%%\n",
+				1 << largestOrder, 100 - (numOfFramesInMaxBlocks * 100) / buddyNumOfFreeFrames);
+	}
+	cprintf("Splits = %d, merges = %d, failed allocations per order:", buddyNumOfSplits, buddyNumOfMerges);
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++)
+		cprintf(" %d", buddyNumOfFailures[order]);
+	cprintf("\n");
+}
@@ -0,0 +1,25 @@
+#ifndef FOS_KERN_BUDDY_H_
+#define FOS_KERN_BUDDY_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/memlayout.h>
+
+// Buddy allocator of the physical frames that are free and not buffered.
+// A free block of order k is 2^k physically contiguous frames starting at a frame number
+// that is a multiple of 2^k. Only its first frame is linked in the free list of its order.
+
+#define BUDDY_MAX_ORDER 10 // largest block = 1024 frames (4 MB)
+
+extern struct Linked_List buddy_free_lists[BUDDY_MAX_ORDER + 1];
+
+void buddy_initialize();
+struct Frame_Info *buddy_allocate_block(uint32 order);
+void buddy_free_block(struct Frame_Info *ptr_frame_info, uint32 order);
+uint32 buddy_num_of_free_frames();
+void buddy_print_statistics();
+
+#endif // FOS_KERN_BUDDY_H_
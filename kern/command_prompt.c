@@ -26,6 +26,15 @@ FUNCTIONS:	readline, cprintf, execute_command, run_command_prompt, command_kerne
 #include <kern/file_manager.h>
 #include <kern/sched.h>
 #include <kern/kheap.h>
+#include <kern/slab.h>
+#include <kern/buddy.h>
+#include <kern/page_replacement.h>
+#include <kern/readahead.h>
+#include <kern/writeback.h>
+#include <kern/pff.h>
+#include <kern/load_control.h>
+#include <kern/disk_queue.h>
+#include <kern/ide_dma.h>
 #include <kern/utilities.h>
 
 // Structure for each command
@@ -56,7 +65,11 @@ int command_set_page_rep_FIFO(int number_of_arguments, char **arguments);
 int command_set_page_rep_CLOCK(int number_of_arguments, char **arguments);
 int command_set_page_rep_LRU(int number_of_arguments, char **arguments);
 int command_set_page_rep_ModifiedCLOCK(int number_of_arguments, char **arguments);
+int command_set_page_rep_ARC(int number_of_arguments, char **arguments);
+int command_set_page_rep_global(int number_of_arguments, char **arguments);
+int command_set_page_rep_local(int number_of_arguments, char **arguments);
 int command_print_page_rep(int number_of_arguments, char **arguments);
+int command_print_page_rep_info(int number_of_arguments, char **arguments);
 
 int command_set_uheap_plac_FIRSTFIT(int number_of_arguments, char **arguments);
 int command_set_uheap_plac_BESTFIT(int number_of_arguments, char **arguments);
@@ -70,6 +83,19 @@ int command_set_kheap_plac_BESTFIT(int number_of_arguments, char **arguments);
 int command_set_kheap_plac_NEXTFIT(int number_of_arguments, char **arguments);
 int command_set_kheap_plac_WORSTFIT(int number_of_arguments, char **arguments);
 int command_print_kheap_plac(int number_of_arguments, char **arguments);
+int command_print_kheap_info(int number_of_arguments, char **arguments);
+int command_print_slab_info(int number_of_arguments, char **arguments);
+int command_kheap_va_benchmark(int number_of_arguments, char **arguments);
+int command_zeroed_frames_pool(int number_of_arguments, char **arguments);
+int command_fault_around(int number_of_arguments, char **arguments);
+int command_readahead(int number_of_arguments, char **arguments);
+int command_writeback(int number_of_arguments, char **arguments);
+int command_pff(int number_of_arguments, char **arguments);
+int command_load_control(int number_of_arguments, char **arguments);
+int command_disk_async(int number_of_arguments, char **arguments);
+int command_disk_dma(int number_of_arguments, char **arguments);
+int command_page_file_info(int number_of_arguments, char **arguments);
+int command_page_file_lazy(int number_of_arguments, char **arguments);
 
 int command_disable_modified_buffer(int number_of_arguments, char **arguments);
 int command_enable_modified_buffer(int number_of_arguments, char **arguments);
@@ -93,6 +119,9 @@ extern int test_kfree_bestfit();
 extern int test_kheap_phys_addr();
 extern int test_kheap_virt_addr();
 extern int test_three_creation_functions();
+extern int test_buddy();
+extern int test_kmem_cache();
+extern int test_kheap_placement();
 
 int command_test_kmalloc(int number_of_arguments, char **arguments);
 int command_test_kfree(int number_of_arguments, char **arguments);
@@ -100,6 +129,9 @@ int command_test_kheap_phys_addr(int number_of_arguments, char **arguments);
 int command_test_kheap_virt_addr(int number_of_arguments, char **arguments);
 int command_test_three_creation_functions(int number_of_arguments, char **arguments);
 int command_test_krealloc(int number_of_arguments, char **arguments);
+int command_test_buddy(int number_of_arguments, char **arguments);
+int command_test_kmem_cache(int number_of_arguments, char **arguments);
+int command_test_kheap_placement(int number_of_arguments, char **arguments);
 
 // 2018
 int command_sch_RR(int number_of_arguments, char **arguments);
@@ -136,7 +168,11 @@ struct Command commands[] =
 		{"fifo", "set replacement algorithm to FIFO", command_set_page_rep_FIFO},
 		{"clock", "set replacement algorithm to CLOCK", command_set_page_rep_CLOCK},
 		{"modifiedclock", "set replacement algorithm to modified CLOCK", command_set_page_rep_ModifiedCLOCK},
+		{"arc", "set replacement algorithm to adaptive replacement (CLOCK with ARC ghost lists)", command_set_page_rep_ARC},
+		{"repglobal", "take page replacement victims from all programs in memory (global clock)", command_set_page_rep_global},
+		{"replocal", "take page replacement victims from the faulting program only [default]", command_set_page_rep_local},
 		{"rep?", "print current replacement algorithm", command_print_page_rep},
+		{"repinfo", "print victims, scanned WS entries and cycles per page replacement algorithm", command_print_page_rep_info},
 
 		{"uhfirstfit", "set USER heap placement strategy to FIRST FIT", command_set_uheap_plac_FIRSTFIT},
 		{"uhbestfit", "set USER heap placement strategy to BEST FIT", command_set_uheap_plac_BESTFIT},
@@ -150,6 +186,19 @@ struct Command commands[] =
 		{"khnextfit", "set KERNEL heap placement strategy to NEXT FIT", command_set_kheap_plac_NEXTFIT},
 		{"khworstfit", "set KERNEL heap placement strategy to WORST FIT", command_set_kheap_plac_WORSTFIT},
 		{"kheap?", "print current KERNEL heap placement strategy", command_print_kheap_plac},
+		{"kheapinfo", "print KERNEL heap fragmentation and allocation latency per placement strategy", command_print_kheap_info},
+		{"slabinfo", "print the usage statistics of the kernel object caches", command_print_slab_info},
+		{"kvabench", "compare kheap_virtual_address scan vs. reverse map on [N] kernel heap pages (run after a program)", command_kheap_va_benchmark},
+		{"zeropool", "print the pre-zeroed frames pool statistics, or set its watermark to [N] frames", command_zeroed_frames_pool},
+		{"faultaround", "print the fault-around window, or set it to [N] pages read with each faulted page (0 = disabled)", command_fault_around},
+		{"readahead", "print the readahead hit rate of each program, or set the max readahead window to [N] pages (0 = disabled)", command_readahead},
+		{"writeback", "print the modified pages cleaned in the background/foreground, or set the background write-back watermarks to [HIGH [LOW]] pages (0 = disabled)", command_writeback},
+		{"pff", "print the WS size of each program, or size the WSs by page fault frequency within [MIN MAX [HIGH [LOW]]] (0 = disabled)", command_pff},
+		{"loadctl", "print the environments swapped out by the load control, or enable it with [HIGH [LOW]] page faults per window (0 = disabled)", command_load_control},
+		{"diskasync", "print the page-file reads done by the disk interrupt, or enable them [1] so faulting programs block instead of spinning (0 = disabled)", command_disk_async},
+		{"diskdma", "print the cycles per MB of the PIO and DMA page-file transfers, or move the pages by bus-master DMA [1] (0 = PIO)", command_disk_dma},
+		{"pfinfo", "print the fragmentation of the page file free space and of the pages of each program", command_page_file_info},
+		{"pflazy", "give the new heap/stack pages disk frames only at their first write-back [1] (0 = at allocation), and print the page file statistics", command_page_file_lazy},
 
 		// 2016
 		{"nobuff", "", command_disable_buffering},
@@ -166,8 +215,10 @@ struct Command commands[] =
 		{"tstkphysaddr", "Kernel Heap: test kheap_phys_addr", command_test_kheap_phys_addr},
 		{"tstkvirtaddr", "Kernel Heap: test kheap_virt_addr", command_test_kheap_virt_addr},
 		{"tst3functions", "Env Load: test the creation of new dir, tables and pages WS", command_test_three_creation_functions},
-		{"tstkrealloc", "Kernel realloc: test realloc (virtual address = 0)", command_test_krealloc}
-
+		{"tstkrealloc", "Kernel realloc: test realloc (virtual address = 0)", command_test_krealloc},
+		{"tstkplacement", "Kernel Heap: test the blocks chosen by the placement strategies", command_test_kheap_placement},
+		{"tstslab", "Slab allocator: test the object caches (full/partial/empty slabs)", command_test_kmem_cache},
+		{"tstbuddy", "Buddy allocator: test the contiguous allocation and the split/coalescing of blocks", command_test_buddy}
 };
 
 // Number of commands = size of the array / size of command structure
@@ -451,6 +502,11 @@ void run_command_prompt()
 		// ********** This DosKey supported readline function is a combined implementation from **********
 		// ********** 		Mohamed Raafat & Mohamed Yousry, 3rd year students, FCIS, 2017		**********
 		// ********** 				Combined, edited and modified by TA\Ghada Hamed				**********
+		// No environment is running while waiting for a command: use this idle time to refill the zeroed frames pool
+		// and to write back the modified buffer
+		refill_zeroed_frames_pool();
+		writeback_on_idle();
+
 		memset(command_line, 0, sizeof(command_line));
 		command_prompt_readline("FOS> ", command_line);
 
@@ -711,6 +767,8 @@ int command_meminfo(int number_of_arguments, char **arguments)
 	cprintf("Total available frames = %d\nFree Buffered = %d\nFree Not Buffered = %d\nModified = %d\n",
 			counters.freeBuffered + counters.freeNotBuffered + counters.modified, counters.freeBuffered, counters.freeNotBuffered, counters.modified);
 
+	buddy_print_statistics();
+
 	cprintf("Num of calls for kheap_virtual_address [in last run] = %d\n", numOfKheapVACalls);
 
 	return 0;
@@ -854,6 +912,27 @@ int command_set_page_rep_ModifiedCLOCK(int number_of_arguments, char **arguments
 	return 0;
 }
 
+int command_set_page_rep_ARC(int number_of_arguments, char **arguments)
+{
+	setPageReplacmentAlgorithmARC();
+	cprintf("Page replacement algorithm is now ARC\n");
+	return 0;
+}
+
+int command_set_page_rep_global(int number_of_arguments, char **arguments)
+{
+	setPageReplacmentGlobal(1);
+	cprintf("Page replacement is now GLOBAL\n");
+	return 0;
+}
+
+int command_set_page_rep_local(int number_of_arguments, char **arguments)
+{
+	setPageReplacmentGlobal(0);
+	cprintf("Page replacement is now LOCAL\n");
+	return 0;
+}
+
 /*2018*/ // BEGIN======================================================
 int command_sch_RR(int number_of_arguments, char **arguments)
 {
@@ -927,12 +1006,21 @@ int command_print_page_rep(int number_of_arguments, char **arguments)
 		cprintf("Page replacement algorithm is FIFO\n");
 	else if (isPageReplacmentAlgorithmModifiedCLOCK())
 		cprintf("Page replacement algorithm is Modified CLOCK\n");
+	else if (isPageReplacmentAlgorithmARC())
+		cprintf("Page replacement algorithm is ARC\n");
 	else
 		cprintf("Page replacement algorithm is UNDEFINED\n");
+	cprintf("Page replacement is %s\n", isPageReplacmentGlobal() ? "GLOBAL" : "LOCAL");
 
 	return 0;
 }
 
+int command_print_page_rep_info(int number_of_arguments, char **arguments)
+{
+	page_replacement_print_statistics();
+	return 0;
+}
+
 int command_set_uheap_plac_FIRSTFIT(int number_of_arguments, char **arguments)
 {
 	setUHeapPlacementStrategyFIRSTFIT();
@@ -1032,6 +1120,126 @@ int command_print_kheap_plac(int number_of_arguments, char **arguments)
 	return 0;
 }
 
+int command_print_kheap_info(int number_of_arguments, char **arguments)
+{
+	kheap_print_statistics();
+	return 0;
+}
+
+int command_print_slab_info(int number_of_arguments, char **arguments)
+{
+	kmem_cache_print_statistics();
+	return 0;
+}
+
+int command_kheap_va_benchmark(int number_of_arguments, char **arguments)
+{
+	uint32 numOfPages = 1024;
+	if (number_of_arguments >= 2)
+		numOfPages = strtol(arguments[1], NULL, 10);
+	kheap_virtual_address_benchmark(numOfPages);
+	return 0;
+}
+
+int command_zeroed_frames_pool(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+	{
+		zeroed_frames_pool_watermark = strtol(arguments[1], NULL, 10);
+		refill_zeroed_frames_pool();
+	}
+	print_zeroed_frames_pool_statistics();
+	return 0;
+}
+
+int command_fault_around(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+		setFaultAroundWindow(strtol(arguments[1], NULL, 10));
+	cprintf("Fault-around window = %d pages (max %d), pages brought in by fault-around = %d\n",
+			getFaultAroundWindow(), FAULT_AROUND_MAX_WINDOW, faultAroundNumOfPages);
+	return 0;
+}
+
+int command_readahead(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+		setReadaheadMaxWindow(strtol(arguments[1], NULL, 10));
+	readahead_print_statistics();
+	return 0;
+}
+
+int command_writeback(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+	{
+		uint32 high = strtol(arguments[1], NULL, 10);
+		uint32 low = (number_of_arguments >= 3) ? strtol(arguments[2], NULL, 10) : high / 2;
+		setWritebackWatermarks(high, low);
+	}
+	writeback_print_statistics();
+	return 0;
+}
+
+int command_pff(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments == 2 && strtol(arguments[1], NULL, 10) == 0)
+		pff_disable();
+	else if (number_of_arguments >= 3)
+	{
+		uint32 high = (number_of_arguments >= 4) ? strtol(arguments[3], NULL, 10) : PFF_DEFAULT_HIGH_FAULTS;
+		uint32 low = (number_of_arguments >= 5) ? strtol(arguments[4], NULL, 10) : PFF_DEFAULT_LOW_FAULTS;
+		pff_enable(strtol(arguments[1], NULL, 10), strtol(arguments[2], NULL, 10), high, low);
+	}
+	pff_print_statistics();
+	return 0;
+}
+
+int command_load_control(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+	{
+		uint32 high = strtol(arguments[1], NULL, 10);
+		uint32 low = (number_of_arguments >= 3) ? strtol(arguments[2], NULL, 10) : LOAD_CONTROL_DEFAULT_LOW_FAULTS;
+		if (high == 0)
+			load_control_disable();
+		else
+			load_control_enable(high, low);
+	}
+	load_control_print_statistics();
+	return 0;
+}
+
+int command_disk_async(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+		setDiskAsyncReads(strtol(arguments[1], NULL, 10) != 0);
+	disk_queue_print_statistics();
+	return 0;
+}
+
+int command_disk_dma(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2 && setDiskDMA(strtol(arguments[1], NULL, 10) != 0) != 0)
+		cprintf("No bus-master IDE controller: PIO is kept\n");
+	ide_dma_print_statistics();
+	return 0;
+}
+
+int command_page_file_info(int number_of_arguments, char **arguments)
+{
+	pf_print_statistics();
+	return 0;
+}
+
+int command_page_file_lazy(int number_of_arguments, char **arguments)
+{
+	if (number_of_arguments >= 2)
+		setPageFileLazyAllocation(strtol(arguments[1], NULL, 10) != 0);
+	pf_print_statistics();
+	return 0;
+}
+
 /*2017*/ // END======================================================
 
 int command_disable_modified_buffer(int number_of_arguments, char **arguments)
@@ -1200,4 +1408,22 @@ int command_test_krealloc(int number_of_arguments, char **arguments)
 	return 0;
 }
 
+int command_test_kheap_placement(int number_of_arguments, char **arguments)
+{
+	test_kheap_placement();
+	return 0;
+}
+
+int command_test_kmem_cache(int number_of_arguments, char **arguments)
+{
+	test_kmem_cache();
+	return 0;
+}
+
+int command_test_buddy(int number_of_arguments, char **arguments)
+{
+	test_buddy();
+	return 0;
+}
+
 // END======================================================
@@ -0,0 +1,157 @@
+#include <inc/stdio.h>
+#include <inc/disk.h>
+#include <inc/error.h>
+#include <kern/disk_queue.h>
+#include <kern/picirq.h>
+#include <kern/sched.h>
+#include <kern/ide_dma.h>
+
+// FIFO of the requests: the one at queueHead is in progress on the disk
+static struct Disk_Request requests[DISK_QUEUE_MAX_REQUESTS];
+static uint32 queueHead;
+static uint32 queueSize;
+
+void setDiskAsyncReads(uint8 enable)
+{
+	if (enable)
+	{
+		ide_enable_interrupts(1);
+		irq_devices_8259A |= (1 << (IRQ14_Disk - IRQ_OFFSET)) | (1 << IRQ_SLAVE);
+	}
+	else
+	{
+		disk_queue_drain();
+		irq_devices_8259A &= ~((1 << (IRQ14_Disk - IRQ_OFFSET)) | (1 << IRQ_SLAVE));
+	}
+	_DiskAsyncReadsEnabled = enable;
+}
+uint8 isDiskAsyncReadsEnabled() { return _DiskAsyncReadsEnabled; }
+
+// Start reading the head request: by DMA into its frame, or by PIO into its frame mapped at the disk I/O window
+static void disk_queue_start()
+{
+	struct Disk_Request *req = &requests[queueHead];
+	req->dma = isDiskDMAEnabled() && req->numOfSectors == PAGE_SIZE / SECTSIZE;
+	if (req->dma)
+	{
+		uint32 physical_address = to_physical_address(req->frame);
+		ide_dma_start(req->secno, &physical_address, 1, 0);
+		return;
+	}
+
+	uint32 *ptr_page_table;
+	get_page_table(ptr_page_directory, (void *)KERNEL_DISK_IO_WINDOW, &ptr_page_table);
+	ptr_page_table[PTX(KERNEL_DISK_IO_WINDOW)] = CONSTRUCT_ENTRY(to_physical_address(req->frame), PERM_PRESENT | PERM_WRITEABLE);
+	tlb_invalidate(ptr_page_directory, (void *)KERNEL_DISK_IO_WINDOW);
+
+	ide_start_read(req->secno, req->numOfSectors);
+}
+
+// Queue a read of numOfSectors sectors from secno into the given frame for env e.
+// Return E_NO_MEM if the queue is full [then the caller should read synchronously]
+int disk_queue_read(uint32 secno, uint32 numOfSectors, struct Frame_Info *ptr_frame_info, struct Env *e)
+{
+	assert(numOfSectors <= PAGE_SIZE / SECTSIZE);
+	if (queueSize == DISK_QUEUE_MAX_REQUESTS)
+	{
+		diskQueueNumOfFullQueueFallbacks++;
+		return E_NO_MEM;
+	}
+
+	struct Disk_Request *req = &requests[(queueHead + queueSize) % DISK_QUEUE_MAX_REQUESTS];
+	req->secno = secno;
+	req->numOfSectors = numOfSectors;
+	req->numOfDoneSectors = 0;
+	req->frame = ptr_frame_info;
+	req->env = e;
+	queueSize++;
+	diskQueueNumOfRequests++;
+
+	if (queueSize == 1)
+		disk_queue_start();
+	return 0;
+}
+
+uint8 disk_queue_has_request(struct Env *e)
+{
+	for (uint32 i = 0; i < queueSize; i++)
+	{
+		if (requests[(queueHead + i) % DISK_QUEUE_MAX_REQUESTS].env == e)
+			return 1;
+	}
+	return 0;
+}
+
+uint32 disk_queue_size() { return queueSize; }
+
+// Take the next sector of the head request if the disk has it ready [or check if its DMA is done]. When it's
+// the last one, wake up the env of the request and start the next one. Return 0 if there was progress
+static int disk_queue_service()
+{
+	if (queueSize == 0)
+		return 1;
+
+	struct Disk_Request *req = &requests[queueHead];
+	int r;
+	if (req->dma)
+		r = ide_dma_poll();
+	else
+		r = ide_read_sector((void *)(KERNEL_DISK_IO_WINDOW + req->numOfDoneSectors * SECTSIZE));
+	if (r < 0)
+		panic("Error reading from disk\n");
+	if (r == 1)
+		return 1;
+
+	req->numOfDoneSectors = req->dma ? req->numOfSectors : req->numOfDoneSectors + 1;
+	if (req->numOfDoneSectors < req->numOfSectors)
+		return 0;
+
+	if (!req->dma)
+	{
+		uint32 *ptr_page_table;
+		get_page_table(ptr_page_directory, (void *)KERNEL_DISK_IO_WINDOW, &ptr_page_table);
+		ptr_page_table[PTX(KERNEL_DISK_IO_WINDOW)] = 0;
+		tlb_invalidate(ptr_page_directory, (void *)KERNEL_DISK_IO_WINDOW);
+	}
+
+	// the env is still running if the request is done before the page fault handler blocks it
+	struct Env *e = req->env;
+	queueHead = (queueHead + 1) % DISK_QUEUE_MAX_REQUESTS;
+	queueSize--;
+	if (e->env_status == ENV_BLOCKED)
+		sched_insert_ready(e);
+
+	if (queueSize > 0)
+		disk_queue_start();
+	return 0;
+}
+
+// Disk interrupt [IRQ14]: it comes only while an env runs. A stale one (e.g. raised by a synchronous command
+// while the kernel polled the disk) finds no sector ready and is ignored
+void disk_queue_interrupt()
+{
+	if (disk_queue_service() == 0)
+		diskQueueNumOfInterrupts++;
+
+	// the slave 8259A isn't in automatic EOI mode
+	outb(IO_PIC2, 0x20);
+}
+
+// Complete all the queued requests by polling the disk
+void disk_queue_drain()
+{
+	while (queueSize > 0)
+	{
+		if (disk_queue_service() == 0)
+			diskQueueNumOfPolledSectors++;
+	}
+}
+
+void disk_queue_print_statistics()
+{
+	cprintf("Interrupt-driven page-file reads: %s\n", isDiskAsyncReadsEnabled() ? "ENABLED" : "DISABLED");
+	cprintf("	queued reads = %d, in the queue = %d, done synchronously as the queue was full = %d\n",
+			diskQueueNumOfRequests, queueSize, diskQueueNumOfFullQueueFallbacks);
+	cprintf("	sectors [or DMA requests] done by the disk interrupt = %d, by polling = %d\n",
+			diskQueueNumOfInterrupts, diskQueueNumOfPolledSectors);
+}
@@ -0,0 +1,50 @@
+#ifndef FOS_KERN_DISK_QUEUE_H_
+#define FOS_KERN_DISK_QUEUE_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/environment_definitions.h>
+#include <kern/memory_manager.h>
+
+// Interrupt-driven page-file reads: when enabled, a page fault from user mode that has to read its page
+// from the page file queues the read here and the faulting environment is BLOCKED, so the scheduler runs
+// another one meanwhile. The head request is in progress on the disk: each sector is taken by the disk
+// interrupt [IRQ14] into the frame mapped at KERNEL_DISK_IO_WINDOW (or the whole page is moved by DMA),
+// and the last one moves the env back to the READY queue (it re-executes the faulting instruction on the
+// page that is now present) and starts the next request. The kernel runs with interrupts disabled, so the
+// queue is drained by polling the disk before any synchronous disk command and when there's nothing else
+// to run.
+
+#define DISK_QUEUE_MAX_REQUESTS 64
+
+struct Disk_Request
+{
+	uint32 secno;
+	uint32 numOfSectors;
+	uint32 numOfDoneSectors;
+	struct Frame_Info *frame; // the sectors are read at its start
+	struct Env *env;		  // blocked till the request is done
+	uint8 dma;				  // read by bus-master DMA [see kern/ide_dma.c]
+};
+
+uint8 _DiskAsyncReadsEnabled;
+
+uint32 diskQueueNumOfRequests;
+uint32 diskQueueNumOfInterrupts;		 // disk interrupts that took a sector or ended a DMA request
+uint32 diskQueueNumOfPolledSectors;		 // the same while draining the queue
+uint32 diskQueueNumOfFullQueueFallbacks; // reads done synchronously as the queue was full
+
+void setDiskAsyncReads(uint8 enable);
+uint8 isDiskAsyncReadsEnabled();
+
+int disk_queue_read(uint32 secno, uint32 numOfSectors, struct Frame_Info *ptr_frame_info, struct Env *e);
+uint8 disk_queue_has_request(struct Env *e);
+uint32 disk_queue_size();
+void disk_queue_interrupt();
+void disk_queue_drain();
+void disk_queue_print_statistics();
+
+#endif // FOS_KERN_DISK_QUEUE_H_
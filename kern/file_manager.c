@@ -22,6 +22,8 @@ FUNCTIONS:	to_physical_address, get_frame_info, tlb_invalidate
 #include <kern/file_manager.h>
 #include <kern/memory_manager.h>
 #include <kern/kheap.h>
+#include <kern/disk_queue.h>
+#include <kern/ide_dma.h>
 
 int pf_add_env_page(struct Env *ptr_env, uint32 virtual_address, void *ptrDataSrc);
 int __pf_write_env_table(struct Env *ptr_env, uint32 virtual_address, uint32 *tableKVirtualAddress);
@@ -29,12 +31,23 @@ int __pf_read_env_table(struct Env *ptr_env, uint32 virtual_address, uint32 *tab
 void __pf_remove_env_all_tables(struct Env *ptr_env);
 void __pf_remove_env_table(struct Env *ptr_env, uint32 virtual_address);
 
+static void disk_transfer_account(int path, uint32 numOfPages, uint64 startCycles)
+{
+	diskTransferStats[path].numOfCommands++;
+	diskTransferStats[path].numOfBytes += numOfPages * PAGE_SIZE;
+	diskTransferStats[path].totalCycles += read_tsc() - startCycles;
+}
+
 int read_disk_page(uint32 dfn, void *va)
 {
 	uint32 df_start_sector = PAGE_FILE_START_SECTOR + dfn * SECTOR_PER_PAGE;
 
+	// the disk is free for a synchronous command only after the queued page-file reads
+	disk_queue_drain();
 	// LOG_STATMENT( cprintf("reading from disk to mem addr %x at sector %d\n",va,df_start_sector);  );
+	uint64 startCycles = read_tsc();
 	int success = ide_read(df_start_sector, (void *)va, SECTOR_PER_PAGE);
+	disk_transfer_account(DISK_PIO, 1, startCycles);
 	// LOG_STATMENT( if(success==0) {cprintf("read from disk successuflly.\n");} else {cprintf("read from disk failed !!\n");} );
 
 	return success;
@@ -44,9 +57,12 @@ int write_disk_page(uint32 dfn, void *va)
 {
 	// write disk at wanted frame
 	uint32 df_start_sector = PAGE_FILE_START_SECTOR + dfn * SECTOR_PER_PAGE;
+	disk_queue_drain();
 
 	// LOG_STATMENT( cprintf(">>> writing to disk from mem addr %x at sector %d\n",va,df_start_sector);  );
+	uint64 startCycles = read_tsc();
 	int success = ide_write(df_start_sector, (void *)va, SECTOR_PER_PAGE);
+	disk_transfer_account(DISK_PIO, 1, startCycles);
 	// LOG_STATMENT( if(success==0) {cprintf(">>> written to disk successfully.\n");} else {cprintf(">>> written to disk failed !!\n");} );
 
 	if (success != 0)
@@ -54,12 +70,109 @@ int write_disk_page(uint32 dfn, void *va)
 	return success;
 }
 
+// Read/write numOfPages pages at consecutive disk frames starting at dfn from/to the kernel buffer at va by one
+// disk command
+static int read_disk_run(uint32 dfn, void *va, uint32 numOfPages)
+{
+	assert(numOfPages * SECTOR_PER_PAGE <= MAX_SECTORS_PER_DISK_COMMAND);
+	uint32 df_start_sector = PAGE_FILE_START_SECTOR + dfn * SECTOR_PER_PAGE;
+	disk_queue_drain();
+	uint64 startCycles = read_tsc();
+	int success = ide_read(df_start_sector, va, numOfPages * SECTOR_PER_PAGE);
+	disk_transfer_account(DISK_PIO, numOfPages, startCycles);
+	return success;
+}
+
+static int write_disk_run(uint32 dfn, void *va, uint32 numOfPages)
+{
+	assert(numOfPages * SECTOR_PER_PAGE <= MAX_SECTORS_PER_DISK_COMMAND);
+	uint32 df_start_sector = PAGE_FILE_START_SECTOR + dfn * SECTOR_PER_PAGE;
+	disk_queue_drain();
+	uint64 startCycles = read_tsc();
+	int success = ide_write(df_start_sector, va, numOfPages * SECTOR_PER_PAGE);
+	disk_transfer_account(DISK_PIO, numOfPages, startCycles);
+	if (success != 0)
+		panic("Error writing on disk\n");
+	return success;
+}
+
+// Move the given pages, whose disk frames are consecutive, by one disk command: by bus-master DMA from/to their
+// frames [see kern/ide_dma.c], or by PIO through their frames mapped in order at the kernel disk window
+static int transfer_disk_run(struct Disk_Page *pages, uint32 numOfPages, uint8 write)
+{
+	assert(numOfPages <= KERNEL_DISK_WINDOW_PAGES);
+	int success;
+	if (isDiskDMAEnabled())
+	{
+		static uint32 physical_addresses[KERNEL_DISK_WINDOW_PAGES];
+		for (uint32 i = 0; i < numOfPages; i++)
+			physical_addresses[i] = to_physical_address(pages[i].frame);
+		disk_queue_drain();
+		uint64 startCycles = read_tsc();
+		success = ide_dma_transfer(PAGE_FILE_START_SECTOR + pages[0].dfn * SECTOR_PER_PAGE, physical_addresses, numOfPages, write);
+		disk_transfer_account(DISK_DMA, numOfPages, startCycles);
+		if (write && success != 0)
+			panic("Error writing on disk\n");
+		return success;
+	}
+
+	uint32 *ptr_page_table;
+	get_page_table(ptr_page_directory, (void *)KERNEL_DISK_WINDOW, &ptr_page_table);
+	for (uint32 i = 0; i < numOfPages; i++)
+	{
+		uint32 va = KERNEL_DISK_WINDOW + i * PAGE_SIZE;
+		ptr_page_table[PTX(va)] = CONSTRUCT_ENTRY(to_physical_address(pages[i].frame), PERM_PRESENT | PERM_WRITEABLE);
+		tlb_invalidate(ptr_page_directory, (void *)va);
+	}
+
+	if (write)
+		success = write_disk_run(pages[0].dfn, (void *)KERNEL_DISK_WINDOW, numOfPages);
+	else
+		success = read_disk_run(pages[0].dfn, (void *)KERNEL_DISK_WINDOW, numOfPages);
+
+	for (uint32 i = 0; i < numOfPages; i++)
+	{
+		uint32 va = KERNEL_DISK_WINDOW + i * PAGE_SIZE;
+		ptr_page_table[PTX(va)] = 0;
+		tlb_invalidate(ptr_page_directory, (void *)va);
+	}
+	return success;
+}
+
+// Read/write the given pages [(disk frame, frame) pairs] from/to the page file: each run of consecutive disk frames
+// in the given order is moved by one disk command [of up to MAX_SECTORS_PER_DISK_COMMAND sectors]
+static int transfer_disk_pages(struct Disk_Page *pages, uint32 numOfPages, uint8 write)
+{
+	uint32 runStart = 0;
+	for (uint32 i = 1; i <= numOfPages; i++)
+	{
+		uint32 runLength = i - runStart;
+		if (i == numOfPages || pages[i].dfn != pages[runStart].dfn + runLength || runLength == KERNEL_DISK_WINDOW_PAGES)
+		{
+			int success = transfer_disk_run(&pages[runStart], runLength, write);
+			if (success != 0)
+				return success;
+			runStart = i;
+		}
+	}
+	return 0;
+}
+
+int read_disk_pages(struct Disk_Page *pages, uint32 numOfPages)
+{
+	return transfer_disk_pages(pages, numOfPages, 0);
+}
+
+int write_disk_pages(struct Disk_Page *pages, uint32 numOfPages)
+{
+	return transfer_disk_pages(pages, numOfPages, 1);
+}
+
 ///========================== PAGE FILE MANAGMENT ==============================
 
 uint32 *ptr_disk_page_directory;
 
 struct Frame_Info *disk_frames_info;
-struct Linked_List disk_free_frame_list;
 
 void initialize_disk_page_file();
 
@@ -67,48 +180,97 @@ int read_disk_page(uint32 dfn, void *va);
 int write_disk_page(uint32 dfn, void *va);
 
 int get_disk_page_directory(struct Env *ptr_env, uint32 **ptr_disk_page_directory);
+static uint32 pf_get_env_page_dfn(struct Env *ptr_env, uint32 virtual_address);
 
 // --------------------------------------------------------------
-// Tracking of physical frames.
-// The 'frames_info' array has one 'struct Frame_Info' entry per physical frame.
-// frames_info are reference counted, and free frames are kept on a linked list.
+// Tracking of the disk frames of the page file.
+// A bitmap has one bit per disk frame, set if it's free [disk frame 0 is never used].
+// The pages of an environment are given disk frames next to the ones of their neighbor pages
+// when possible, and a range of pages is given one run of consecutive disk frames, so that the
+// page-file I/O of consecutive pages can be clustered [see read_disk_pages()/write_disk_pages()]
 // --------------------------------------------------------------
 
-// Initialize paging structure and disk_free_frame_list.
-// After this point, ONLY use the functions below
-// to allocate and deallocate physical memory via the disk_free_frame_list,
-// and NEVER use boot_allocate_space() or the related boot-time functions above.
-//
-void initialize_disk_page_file()
+static uint32 diskFreeBitmap[(PAGES_PER_FILE + 31) / 32];
+static uint32 diskNumOfFreeFrames;
+static uint32 diskAllocCursor = 1; // next-fit: the search for a free run starts after the last allocation
+
+void setPageFileLazyAllocation(uint8 enable) { _PageFileLazyAllocation = enable; }
+uint8 isPageFileLazyAllocation() { return _PageFileLazyAllocation; }
+
+// The disk frame of a disk page table entry [0 for a page only reserved in the page file]
+static inline uint32 disk_entry_dfn(uint32 entry)
 {
-	int i;
-	LIST_INIT(&disk_free_frame_list);
+	return (entry == DISK_PAGE_RESERVED) ? 0 : entry;
+}
 
-	// LOG_STATMENT(cprintf("PAGES_PER_FILE = %d, PAGE_FILE_START_SECTOR = %d\n",PAGES_PER_FILE,PAGE_FILE_START_SECTOR););
-	for (i = 1; i < PAGES_PER_FILE; i++)
-	{
-		initialize_frame_info(&(disk_frames_info[i]));
+static inline uint8 disk_frame_is_free(uint32 dfn)
+{
+	return (diskFreeBitmap[dfn >> 5] >> (dfn & 31)) & 1;
+}
 
-		// disk_frames_info[i].references = 0;
-		LIST_INSERT_HEAD(&disk_free_frame_list, &disk_frames_info[i]);
-	}
+static void disk_frame_take(uint32 dfn)
+{
+	assert(disk_frame_is_free(dfn));
+	diskFreeBitmap[dfn >> 5] &= ~(1 << (dfn & 31));
+	diskNumOfFreeFrames--;
+	diskAllocCursor = (dfn + 1 < PAGES_PER_FILE) ? dfn + 1 : 1;
 }
 
-//
-// Initialize a Frame_Info structure.
-// The result has null links and 0 references.
-// Note that the corresponding physical frame is NOT initialized!
-//
-static inline uint32 to_disk_frame_number(struct Frame_Info *ptr_frame_info)
+// Initialize the bitmap of the page file: all its disk frames are free
+void initialize_disk_page_file()
 {
-	return ptr_frame_info - disk_frames_info;
+	memset(diskFreeBitmap, 0, sizeof(diskFreeBitmap));
+	for (uint32 dfn = 1; dfn < PAGES_PER_FILE; dfn++)
+		diskFreeBitmap[dfn >> 5] |= 1 << (dfn & 31);
+	diskNumOfFreeFrames = PAGES_PER_FILE - 1;
+	diskAllocCursor = 1;
+}
+
+// Return the first disk frame of a run of numOfFrames free ones, searching from the allocation cursor [next-fit],
+// or 0 if there's no such run
+static uint32 disk_find_free_run(uint32 numOfFrames)
+{
+	uint32 runStart = 0, runLength = 0;
+	uint32 dfn = diskAllocCursor;
+	// start at the beginning of the free run that holds the cursor: a run that straddles the cursor would
+	// otherwise be cut in two by the scan [its head is only reached after the wrap, where the scan stops]
+	if (disk_frame_is_free(dfn))
+	{
+		while (dfn > 1 && disk_frame_is_free(dfn - 1))
+			dfn--;
+	}
+	for (uint32 k = 0; k < PAGES_PER_FILE; k++, dfn++)
+	{
+		if (dfn == PAGES_PER_FILE)
+		{
+			// the runs don't wrap around the end of the page file
+			dfn = 1;
+			runLength = 0;
+		}
+		if ((dfn & 31) == 0 && diskFreeBitmap[dfn >> 5] == 0)
+		{
+			// skip a word of used frames
+			k += 31;
+			dfn += 31;
+			runLength = 0;
+			continue;
+		}
+		if (!disk_frame_is_free(dfn))
+		{
+			runLength = 0;
+			continue;
+		}
+		if (runLength == 0)
+			runStart = dfn;
+		if (++runLength == numOfFrames)
+			return runStart;
+	}
+	return 0;
 }
 
 //
-// Allocates a disk frame.
-//
-// *ptr_frame_info -- is set to point to the Frame_Info struct of the
-// newly allocated frame
+// Allocates a disk frame: the first one of a free run of DISK_ALLOC_EXTENT_FRAMES frames if there's one
+// [leaving room for the following pages], otherwise any free frame.
 //
 // RETURNS
 //   0 -- on success
@@ -116,26 +278,64 @@ static inline uint32 to_disk_frame_number(struct Frame_Info *ptr_frame_info)
 //
 int allocate_disk_frame(uint32 *dfn)
 {
-	// Fill this function in
-	struct Frame_Info *ptr_frame_info = LIST_FIRST(&disk_free_frame_list);
-	if (ptr_frame_info == NULL)
+	if (diskNumOfFreeFrames == 0)
+		return E_NO_PAGE_FILE_SPACE;
+
+	*dfn = disk_find_free_run(DISK_ALLOC_EXTENT_FRAMES);
+	if (*dfn == 0)
+		*dfn = disk_find_free_run(1);
+	disk_frame_take(*dfn);
+	diskAllocStats.numOfScatteredFrames++;
+	return 0;
+}
+
+// Allocate a run of numOfFrames consecutive disk frames and set first_dfn to the first one.
+// Return E_NO_PAGE_FILE_SPACE if there's no such run
+int allocate_disk_frames(uint32 numOfFrames, uint32 *first_dfn)
+{
+	if (numOfFrames == 0 || numOfFrames > diskNumOfFreeFrames)
 		return E_NO_PAGE_FILE_SPACE;
 
-	LIST_REMOVE(&disk_free_frame_list, ptr_frame_info);
-	initialize_frame_info(ptr_frame_info);
-	*dfn = to_disk_frame_number(ptr_frame_info);
+	*first_dfn = disk_find_free_run(numOfFrames);
+	if (*first_dfn == 0)
+		return E_NO_PAGE_FILE_SPACE;
+	for (uint32 i = 0; i < numOfFrames; i++)
+		disk_frame_take(*first_dfn + i);
+	diskAllocStats.numOfRunFrames += numOfFrames;
 	return 0;
 }
 
+// Allocate a disk frame for the given page of the env: next to the disk frame of its previous/next page if it's free
+static int allocate_env_disk_frame(struct Env *ptr_env, uint32 virtual_address, uint32 *dfn)
+{
+	uint32 prev = (virtual_address >= PAGE_SIZE) ? pf_get_env_page_dfn(ptr_env, virtual_address - PAGE_SIZE) : 0;
+	if (prev != 0 && prev + 1 < PAGES_PER_FILE && disk_frame_is_free(prev + 1))
+	{
+		*dfn = prev + 1;
+		disk_frame_take(*dfn);
+		diskAllocStats.numOfNeighborFrames++;
+		return 0;
+	}
+	uint32 next = (virtual_address + PAGE_SIZE < USER_TOP) ? pf_get_env_page_dfn(ptr_env, virtual_address + PAGE_SIZE) : 0;
+	if (next > 1 && disk_frame_is_free(next - 1))
+	{
+		*dfn = next - 1;
+		disk_frame_take(*dfn);
+		diskAllocStats.numOfNeighborFrames++;
+		return 0;
+	}
+	return allocate_disk_frame(dfn);
+}
+
 //
-// Return a frame to the disk_free_frame_list.
+// Return a frame to the free disk frames.
 //
 void free_disk_frame(uint32 dfn)
 {
-	// Fill this function in
-	if (dfn == 0)
+	if (dfn == 0 || disk_frame_is_free(dfn))
 		return;
-	LIST_INSERT_HEAD(&disk_free_frame_list, &disk_frames_info[dfn]);
+	diskFreeBitmap[dfn >> 5] |= 1 << (dfn & 31);
+	diskNumOfFreeFrames++;
 }
 
 int get_disk_page_table(uint32 *ptr_disk_page_directory, const void *virtual_address, int create, uint32 **ptr_disk_page_table)
@@ -198,6 +398,10 @@ int get_disk_page_table(uint32 *ptr_disk_page_directory, const void *virtual_add
 
 int pf_add_empty_env_page(struct Env *ptr_env, uint32 virtual_address, uint8 initializeByZero)
 {
+	// a new page is all zeros till it's first written back [lazy page-file allocation]
+	if (isPageFileLazyAllocation())
+		return pf_reserve_env_pages(ptr_env, virtual_address, 1);
+
 	// 2016: FIX:
 	if (initializeByZero)
 		return pf_add_env_page(ptr_env, virtual_address, ptr_zero_page);
@@ -209,10 +413,10 @@ int pf_add_empty_env_page(struct Env *ptr_env, uint32 virtual_address, uint8 ini
 
 	get_disk_page_table(ptr_env->disk_env_pgdir, (void *)virtual_address, 1, &ptr_disk_page_table);
 
-	uint32 dfn = ptr_disk_page_table[PTX(virtual_address)];
+	uint32 dfn = disk_entry_dfn(ptr_disk_page_table[PTX(virtual_address)]);
 	if (dfn == 0)
 	{
-		if (allocate_disk_frame(&dfn) == E_NO_PAGE_FILE_SPACE)
+		if (allocate_env_disk_frame(ptr_env, virtual_address, &dfn) == E_NO_PAGE_FILE_SPACE)
 			return E_NO_PAGE_FILE_SPACE;
 		ptr_disk_page_table[PTX(virtual_address)] = dfn;
 	}
@@ -230,10 +434,10 @@ int pf_add_env_page(struct Env *ptr_env, uint32 virtual_address, void *dataSrc)
 
 	get_disk_page_table(ptr_env->disk_env_pgdir, (void *)virtual_address, 1, &ptr_disk_page_table);
 
-	uint32 dfn = ptr_disk_page_table[PTX(virtual_address)];
+	uint32 dfn = disk_entry_dfn(ptr_disk_page_table[PTX(virtual_address)]);
 	if (dfn == 0)
 	{
-		if (allocate_disk_frame(&dfn) == E_NO_PAGE_FILE_SPACE)
+		if (allocate_env_disk_frame(ptr_env, virtual_address, &dfn) == E_NO_PAGE_FILE_SPACE)
 			return E_NO_PAGE_FILE_SPACE;
 		ptr_disk_page_table[PTX(virtual_address)] = dfn;
 	}
@@ -252,47 +456,158 @@ int pf_add_env_page(struct Env *ptr_env, uint32 virtual_address, void *dataSrc)
 	return ret;
 }
 
-int pf_update_env_page(struct Env *ptr_env, void *virtual_address, struct Frame_Info *modified_page_frame_info)
+// Give disk frames to the numOfPages consecutive pages of the env starting at virtual_address that don't have
+// ones yet: one run of consecutive disk frames if there's one, otherwise each one is given a disk frame next to
+// its previous page
+static int pf_allocate_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 numOfPages)
 {
 	uint32 *ptr_disk_page_table;
-	// ROUND DOWN it on 4 KB boundary in order to update the entire page starting from its first address.
-	// virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	assert(virtual_address + numOfPages * PAGE_SIZE <= KERNEL_BASE);
 
-	assert((uint32)virtual_address < KERNEL_BASE);
-	// char c = *((char*)virtual_address);
-	// Get/Create the directory table
 	get_disk_page_directory(ptr_env, &(ptr_env->disk_env_pgdir));
 
-	get_disk_page_table(ptr_env->disk_env_pgdir, virtual_address, 0, &ptr_disk_page_table);
+	uint32 numOfNewPages = 0;
+	for (uint32 i = 0; i < numOfPages; i++)
+	{
+		if (pf_get_env_page_dfn(ptr_env, virtual_address + i * PAGE_SIZE) == 0)
+			numOfNewPages++;
+	}
+	uint32 runDfn = 0;
+	if (numOfNewPages > 1 && allocate_disk_frames(numOfNewPages, &runDfn) != 0)
+		runDfn = 0;
+
+	for (uint32 i = 0; i < numOfPages; i++)
+	{
+		uint32 va = virtual_address + i * PAGE_SIZE;
+		get_disk_page_table(ptr_env->disk_env_pgdir, (void *)va, 1, &ptr_disk_page_table);
+		if (disk_entry_dfn(ptr_disk_page_table[PTX(va)]) != 0)
+			continue;
+		uint32 dfn;
+		if (runDfn != 0)
+			dfn = runDfn++;
+		else if (allocate_env_disk_frame(ptr_env, va, &dfn) == E_NO_PAGE_FILE_SPACE)
+			return E_NO_PAGE_FILE_SPACE;
+		ptr_disk_page_table[PTX(va)] = dfn;
+	}
+	return 0;
+}
+
+// Add numOfPages consecutive pages of the env starting at virtual_address to the page file without data [e.g. the
+// range of allocateMem()]: they're given disk frames [see pf_allocate_env_pages()], or only reserved when the
+// allocation is lazy
+int pf_add_empty_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 numOfPages)
+{
+	if (isPageFileLazyAllocation())
+		return pf_reserve_env_pages(ptr_env, virtual_address, numOfPages);
+	return pf_allocate_env_pages(ptr_env, virtual_address, numOfPages);
+}
+
+// Reserve numOfPages consecutive pages of the env starting at virtual_address in the page file without giving them
+// disk frames [lazy page-file allocation]: only their disk page tables are created. A page that's already there
+// is left as it is
+int pf_reserve_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 numOfPages)
+{
+	uint32 *ptr_disk_page_table;
+	virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	assert(virtual_address + numOfPages * PAGE_SIZE <= KERNEL_BASE);
+
+	if (get_disk_page_directory(ptr_env, &(ptr_env->disk_env_pgdir)) == E_NO_VM)
+		return E_NO_VM;
+
+	for (uint32 i = 0; i < numOfPages; i++)
+	{
+		uint32 va = virtual_address + i * PAGE_SIZE;
+		if (get_disk_page_table(ptr_env->disk_env_pgdir, (void *)va, 1, &ptr_disk_page_table) == E_NO_VM)
+			return E_NO_VM;
+		if (ptr_disk_page_table[PTX(va)] != 0)
+			continue;
+		ptr_disk_page_table[PTX(va)] = DISK_PAGE_RESERVED;
+		diskAllocStats.numOfReservedPages++;
+	}
+	return 0;
+}
+
+// Return 1 if the given page of the env is reserved in the page file without a disk frame [it's all zeros]
+uint8 pf_is_env_page_reserved(struct Env *ptr_env, uint32 virtual_address)
+{
+	uint32 *ptr_disk_page_table;
+	if (ptr_env->disk_env_pgdir == 0)
+		return 0;
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void *)virtual_address, 0, &ptr_disk_page_table);
 	if (ptr_disk_page_table == 0)
-		return E_PAGE_NOT_EXIST_IN_PF;
+		return 0;
+	return ptr_disk_page_table[PTX(virtual_address)] == DISK_PAGE_RESERVED;
+}
 
-	uint32 dfn = ptr_disk_page_table[PTX(virtual_address)];
-	if (dfn == 0)
+// Return in dfn the disk frame to write the given page of the env to: a page that's only reserved in the page file
+// is given its disk frame now, at its first write-back [lazy page-file allocation]
+static int pf_get_env_page_write_dfn(struct Env *ptr_env, uint32 virtual_address, uint32 *dfn)
+{
+	uint32 *ptr_disk_page_table;
+	*dfn = 0;
+	if (ptr_env->disk_env_pgdir == 0)
+		return E_PAGE_NOT_EXIST_IN_PF;
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void *)virtual_address, 0, &ptr_disk_page_table);
+	if (ptr_disk_page_table == 0)
 		return E_PAGE_NOT_EXIST_IN_PF;
 
-	int ret;
-	if (USE_KHEAP)
+	uint32 entry = ptr_disk_page_table[PTX(virtual_address)];
+	if (entry == DISK_PAGE_RESERVED)
 	{
-		// FIX: we should implement a better solution for this, but for now
-		//		we are using an unused VA in the invalid area of kernel at 0xef800000 (the current USER_LIMIT)
-		//		to do temp initialization of a frame.
-		map_frame(ptr_env->env_page_directory, modified_page_frame_info, (void *)USER_LIMIT, 0);
-		ret = write_disk_page(dfn, (void *)ROUNDDOWN(USER_LIMIT, PAGE_SIZE));
-		// TEMPORARILY increase the references to prevent unmap_frame from removing the frame
-		modified_page_frame_info->references += 1;
-		unmap_frame(ptr_env->env_page_directory, (void *)USER_LIMIT);
-		// Return it to its original status
-		modified_page_frame_info->references -= 1;
-
-		// cprintf("[%s] updating page\n",ptr_env->prog_name);
+		if (allocate_env_disk_frame(ptr_env, virtual_address, &entry) == E_NO_PAGE_FILE_SPACE)
+			return E_NO_PAGE_FILE_SPACE;
+		ptr_disk_page_table[PTX(virtual_address)] = entry;
+		diskAllocStats.numOfLazyFrames++;
 	}
-	else
+	if (entry == 0)
+		return E_PAGE_NOT_EXIST_IN_PF;
+	*dfn = entry;
+	return 0;
+}
+
+// Add numOfPages consecutive pages of the env starting at virtual_address to the page file with their data from the
+// kernel buffer at dataSrc [e.g. the program image at env_create()]: each run of pages at consecutive disk frames is
+// written by one disk command. The buffer isn't page-aligned in general, so it's written by PIO
+int pf_add_env_pages(struct Env *ptr_env, uint32 virtual_address, void *dataSrc, uint32 numOfPages)
+{
+	int ret = pf_allocate_env_pages(ptr_env, virtual_address, numOfPages);
+	if (ret != 0)
+		return ret;
+
+	uint32 runStart = 0, runDfn = 0;
+	for (uint32 i = 0; i <= numOfPages; i++)
 	{
-		ret = write_disk_page(dfn, STATIC_KERNEL_VIRTUAL_ADDRESS(to_physical_address(modified_page_frame_info)));
-		// cprintf("[%s] finished updating page\n",ptr_env->prog_name);
+		uint32 dfn = (i < numOfPages) ? pf_get_env_page_dfn(ptr_env, virtual_address + i * PAGE_SIZE) : 0;
+		uint32 runLength = i - runStart;
+		if (runLength > 0 && (i == numOfPages || dfn != runDfn + runLength || runLength == KERNEL_DISK_WINDOW_PAGES))
+		{
+			int disk_write_error = write_disk_run(runDfn, (void *)((uint32)dataSrc + runStart * PAGE_SIZE), runLength);
+			if (disk_write_error != 0)
+				return disk_write_error;
+			runStart = i;
+		}
+		if (runStart == i)
+			runDfn = dfn;
 	}
-	return ret;
+	return 0;
+}
+
+int pf_update_env_page(struct Env *ptr_env, void *virtual_address, struct Frame_Info *modified_page_frame_info)
+{
+	// ROUND DOWN it on 4 KB boundary in order to update the entire page starting from its first address.
+	// virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+
+	assert((uint32)virtual_address < KERNEL_BASE);
+	// char c = *((char*)virtual_address);
+
+	uint32 dfn;
+	int ret = pf_get_env_page_write_dfn(ptr_env, (uint32)virtual_address, &dfn);
+	if (ret != 0)
+		return ret;
+
+	// the frame is moved by DMA or mapped at the kernel disk window [see write_disk_pages()], not at USER_LIMIT
+	struct Disk_Page page = {dfn, modified_page_frame_info};
+	return write_disk_pages(&page, 1);
 }
 /*
 int pf_special_update_env_modified_page(struct Env* ptr_env, uint32 virtual_address, struct Frame_Info* page_modified_frame_info)
@@ -312,6 +627,134 @@ int pf_special_update_env_modified_page(struct Env* ptr_env, uint32 virtual_addr
 	return write_disk_page(dfn, STATIC_KERNEL_VIRTUAL_ADDRESS(to_physical_address(page_modified_frame_info)));
 }
 */
+// Return the disk frame of the given page of the env in the page file, or 0 if it's not there
+static uint32 pf_get_env_page_dfn(struct Env *ptr_env, uint32 virtual_address)
+{
+	uint32 *ptr_disk_page_table;
+	if (ptr_env->disk_env_pgdir == 0)
+		return 0;
+	get_disk_page_table(ptr_env->disk_env_pgdir, (void *)virtual_address, 0, &ptr_disk_page_table);
+	if (ptr_disk_page_table == 0)
+		return 0;
+	return disk_entry_dfn(ptr_disk_page_table[PTX(virtual_address)]);
+}
+
+// Return the number of consecutive pages starting at virtual_address (up to maxNumOfPages) that are in the page file of the env
+uint32 pf_count_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 maxNumOfPages)
+{
+	virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	uint32 n = 0;
+	while (n < maxNumOfPages && virtual_address + n * PAGE_SIZE < USER_TOP && pf_get_env_page_dfn(ptr_env, virtual_address + n * PAGE_SIZE) != 0)
+		n++;
+	return n;
+}
+
+// Read numOfPages consecutive pages of the env starting at virtual_address from the page file into their frames
+// [they should be mapped]: each run of pages at consecutive disk frames is read by one disk command
+int pf_read_env_pages(struct Env *ptr_env, void *virtual_address, uint32 numOfPages)
+{
+	uint32 va = ROUNDDOWN((uint32)virtual_address, PAGE_SIZE);
+	if (pf_count_env_pages(ptr_env, va, numOfPages) < numOfPages)
+		return E_PAGE_NOT_EXIST_IN_PF;
+
+	static struct Disk_Page pages[KERNEL_DISK_WINDOW_PAGES];
+	uint32 *ptr_page_table;
+	for (uint32 start = 0; start < numOfPages; start += KERNEL_DISK_WINDOW_PAGES)
+	{
+		uint32 n = MIN(numOfPages - start, KERNEL_DISK_WINDOW_PAGES);
+		for (uint32 i = 0; i < n; i++)
+		{
+			pages[i].dfn = pf_get_env_page_dfn(ptr_env, va + (start + i) * PAGE_SIZE);
+			pages[i].frame = get_frame_info(ptr_env->env_page_directory, (void *)(va + (start + i) * PAGE_SIZE), &ptr_page_table);
+		}
+		int disk_read_error = read_disk_pages(pages, n);
+		if (disk_read_error != 0)
+			return disk_read_error;
+	}
+
+	// the pages are modified by the kernel only (see pf_read_env_page())
+	for (uint32 i = 0; i < numOfPages; i++)
+		pt_set_page_permissions(ptr_env, va + i * PAGE_SIZE, 0, PERM_MODIFIED);
+	return 0;
+}
+
+// Heap sort of the pages to write back by their disk frame
+static void writeback_sift_down(struct Disk_Page *pages, uint32 i, uint32 n)
+{
+	struct Disk_Page page = pages[i];
+	while (2 * i + 1 < n)
+	{
+		uint32 child = 2 * i + 1;
+		if (child + 1 < n && pages[child + 1].dfn > pages[child].dfn)
+			child++;
+		if (pages[child].dfn <= page.dfn)
+			break;
+		pages[i] = pages[child];
+		i = child;
+	}
+	pages[i] = page;
+}
+
+static void writeback_sort(struct Disk_Page *pages, uint32 n)
+{
+	for (uint32 i = n / 2; i > 0; i--)
+		writeback_sift_down(pages, i - 1, n);
+	for (uint32 last = n; last > 1; last--)
+	{
+		struct Disk_Page tmp = pages[0];
+		pages[0] = pages[last - 1];
+		pages[last - 1] = tmp;
+		writeback_sift_down(pages, 0, last - 1);
+	}
+}
+
+// Sort the given pages by their disk frame and write them: each run of consecutive disk frames is written by one
+// disk command
+static void writeback_sorted_pages(struct Disk_Page *pages, uint32 n)
+{
+	writeback_sort(pages, n);
+	write_disk_pages(pages, n);
+}
+
+// Write back all the frames of the given buffer list (e.g. modified_frame_list) to the page file of their envs
+// [clustered write-back]: the frames are taken by chunks of one disk window, each chunk is sorted by disk frame
+// and each run of consecutive disk frames in it is written by one disk command. The frames are left in the list.
+void pf_update_modified_frames(struct Linked_List *ptr_frames_list)
+{
+	uint32 numOfPages = LIST_SIZE(ptr_frames_list);
+	if (numOfPages == 0)
+		return;
+	uint64 startCycles = read_tsc();
+
+	// a static array [no kernel heap page per flush]: a run isn't longer than a disk window anyway
+	static struct Disk_Page pages[KERNEL_DISK_WINDOW_PAGES];
+	uint32 n = 0;
+	struct Frame_Info *ptr_fi;
+	LIST_FOREACH(ptr_fi, ptr_frames_list)
+	{
+		int ret = pf_get_env_page_write_dfn(ptr_fi->environment, ptr_fi->va, &pages[n].dfn);
+		if (ret == E_PAGE_NOT_EXIST_IN_PF)
+			panic("ERROR: Page doesnt exit in page file!");
+		if (ret == E_NO_PAGE_FILE_SPACE)
+			panic("ERROR: No enough virtual space on the page file!");
+		pages[n].frame = ptr_fi;
+		if (++n == KERNEL_DISK_WINDOW_PAGES)
+		{
+			writeback_sorted_pages(pages, n);
+			n = 0;
+		}
+	}
+	if (n > 0)
+		writeback_sorted_pages(pages, n);
+
+	uint64 cycles = read_tsc() - startCycles;
+	diskFlushStats.numOfFlushes++;
+	diskFlushStats.numOfPages += numOfPages;
+	diskFlushStats.totalCycles += cycles;
+	diskFlushStats.lastNumOfPages = numOfPages;
+	diskFlushStats.lastCycles = cycles;
+}
+
 int pf_read_env_page(struct Env *ptr_env, void *virtual_address)
 {
 	uint32 *ptr_disk_page_table;
@@ -326,12 +769,14 @@ int pf_read_env_page(struct Env *ptr_env, void *virtual_address)
 	if (ptr_disk_page_table == 0)
 		return E_PAGE_NOT_EXIST_IN_PF;
 
-	uint32 dfn = ptr_disk_page_table[PTX(virtual_address)];
+	uint32 dfn = disk_entry_dfn(ptr_disk_page_table[PTX(virtual_address)]);
 
 	if (dfn == 0)
 		return E_PAGE_NOT_EXIST_IN_PF;
 
-	int disk_read_error = read_disk_page(dfn, virtual_address);
+	uint32 *ptr_page_table;
+	struct Disk_Page page = {dfn, get_frame_info(ptr_env->env_page_directory, virtual_address, &ptr_page_table)};
+	int disk_read_error = read_disk_pages(&page, 1);
 
 	// reset modified bit to 0: because FOS copies the placed or replaced page from
 	// HD to memory, the page modified bit is set to 1, but we want the modified bit to be
@@ -341,6 +786,34 @@ int pf_read_env_page(struct Env *ptr_env, void *virtual_address)
 	return disk_read_error;
 }
 
+// Queue the read of the given page from the page file into its frame [already mapped at virtual_address] to
+// the interrupt-driven disk queue: the page fault handler blocks the env till it's done [see kern/disk_queue.c].
+// If the queue is full, the page is read synchronously
+int pf_read_env_page_async(struct Env *ptr_env, void *virtual_address)
+{
+	uint32 *ptr_disk_page_table;
+
+	virtual_address = (void *)ROUNDDOWN((uint32)virtual_address, PAGE_SIZE);
+
+	if (ptr_env->disk_env_pgdir == 0)
+		return E_PAGE_NOT_EXIST_IN_PF;
+
+	get_disk_page_table(ptr_env->disk_env_pgdir, virtual_address, 0, &ptr_disk_page_table);
+	if (ptr_disk_page_table == 0)
+		return E_PAGE_NOT_EXIST_IN_PF;
+
+	uint32 dfn = disk_entry_dfn(ptr_disk_page_table[PTX(virtual_address)]);
+
+	if (dfn == 0)
+		return E_PAGE_NOT_EXIST_IN_PF;
+
+	uint32 *ptr_page_table;
+	struct Frame_Info *ptr_frame_info = get_frame_info(ptr_env->env_page_directory, virtual_address, &ptr_page_table);
+	if (disk_queue_read(PAGE_FILE_START_SECTOR + dfn * SECTOR_PER_PAGE, SECTOR_PER_PAGE, ptr_frame_info, ptr_env) == 0)
+		return 0;
+	return pf_read_env_page(ptr_env, virtual_address);
+}
+
 void pf_remove_env_page(struct Env *ptr_env, uint32 virtual_address)
 {
 	// LOG_STRING("pf_remove_env_page: 0");
@@ -356,7 +829,7 @@ void pf_remove_env_page(struct Env *ptr_env, uint32 virtual_address)
 		return;
 
 	// LOG_STRING("pf_remove_env_page: 2");
-	uint32 dfn = ptr_disk_page_table[PTX(virtual_address)];
+	uint32 dfn = disk_entry_dfn(ptr_disk_page_table[PTX(virtual_address)]);
 	ptr_disk_page_table[PTX(virtual_address)] = 0;
 	free_disk_frame(dfn);
 	// LOG_STRING("pf_remove_env_page: 3");
@@ -388,7 +861,7 @@ void pf_free_env(struct Env *ptr_env)
 		for (pteno = 0; pteno < 1024; pteno++)
 		{
 			// remove the disk page from disk page table
-			uint32 dfn = pt[pteno];
+			uint32 dfn = disk_entry_dfn(pt[pteno]);
 			pt[pteno] = 0;
 			// and declare it free
 			free_disk_frame(dfn);
@@ -500,8 +973,8 @@ int pf_calculate_allocated_pages(struct Env *ptr_env)
 		uint32 ptIndex;
 		for (ptIndex = 0; ptIndex < 1024; ptIndex++)
 		{
-			// remove the disk page from disk page table
-			uint32 dfn = pt[ptIndex];
+			// a page only reserved in the page file doesn't take a disk frame
+			uint32 dfn = disk_entry_dfn(pt[ptIndex]);
 			if (dfn != 0)
 				counter++;
 		}
@@ -514,14 +987,70 @@ int pf_calculate_allocated_pages(struct Env *ptr_env)
 // calculate the disk free frames from the disk free frame list
 int pf_calculate_free_frames()
 {
-	struct Frame_Info *ptr;
-	uint32 totalFreeDiskFrames = 0;
+	return diskNumOfFreeFrames;
+}
 
-	LIST_FOREACH(ptr, &disk_free_frame_list)
+// Print the fragmentation of the page file: of its free space [the free frames out of the largest free run], and of
+// the pages of each env [the consecutive pages in the page file whose disk frames aren't consecutive]
+void pf_print_statistics()
+{
+	uint32 numOfFreeRuns = 0, largestFreeRun = 0, runLength = 0;
+	for (uint32 dfn = 1; dfn <= PAGES_PER_FILE; dfn++)
+	{
+		if (dfn < PAGES_PER_FILE && disk_frame_is_free(dfn))
+		{
+			runLength++;
+			continue;
+		}
+		if (runLength > 0)
+		{
+			numOfFreeRuns++;
+			largestFreeRun = MAX(largestFreeRun, runLength);
+		}
+		runLength = 0;
+	}
+	cprintf("Page file: free frames = %d, free runs = %d, largest free run = %d, free-space fragmentation = %d%%\n",
+			diskNumOfFreeFrames, numOfFreeRuns, largestFreeRun,
+			(diskNumOfFreeFrames > 0) ? 100 - (uint32)(((uint64)largestFreeRun * 100) / diskNumOfFreeFrames) : 0);
+	cprintf("	frames allocated next to a neighbor page = %d, in runs = %d, elsewhere = %d\n",
+			diskAllocStats.numOfNeighborFrames, diskAllocStats.numOfRunFrames, diskAllocStats.numOfScatteredFrames);
+	cprintf("Lazy page-file allocation: %s\n", isPageFileLazyAllocation() ? "ENABLED" : "DISABLED");
+	cprintf("	pages reserved = %d, given a disk frame at their first write-back = %d, zero-filled faults = %d\n",
+			diskAllocStats.numOfReservedPages, diskAllocStats.numOfLazyFrames, diskAllocStats.numOfZeroFilledPages);
+
+	for (struct Env *e = envs; e < envs + NENV; e++)
 	{
-		totalFreeDiskFrames++;
+		if (e->env_status == ENV_FREE || e->disk_env_pgdir == 0)
+			continue;
+		uint32 numOfPages = 0, numOfReservedPages = 0, numOfPairs = 0, numOfBreaks = 0, prevDfn = 0;
+		for (uint32 pdx = 0; pdx < PDX(USER_TOP); pdx++)
+		{
+			if (!(e->disk_env_pgdir[pdx] & PERM_PRESENT))
+			{
+				prevDfn = 0;
+				continue;
+			}
+			for (uint32 ptx = 0; ptx < 1024; ptx++)
+			{
+				uint32 dfn = pf_get_env_page_dfn(e, (uint32)PGADDR(pdx, ptx, 0));
+				if (dfn == 0 && pf_is_env_page_reserved(e, (uint32)PGADDR(pdx, ptx, 0)))
+					numOfReservedPages++;
+				if (dfn != 0)
+				{
+					numOfPages++;
+					if (prevDfn != 0)
+					{
+						numOfPairs++;
+						if (dfn != prevDfn + 1)
+							numOfBreaks++;
+					}
+				}
+				prevDfn = dfn;
+			}
+		}
+		cprintf("[%d] %s:\tpages = %d (+%d reserved), consecutive pages on non-consecutive disk frames = %d of %d (%d%%)\n",
+				e->env_id, e->prog_name, numOfPages, numOfReservedPages, numOfBreaks, numOfPairs, (numOfPairs > 0) ? (numOfBreaks * 100) / numOfPairs : 0);
 	}
-	return totalFreeDiskFrames;
 }
 ///========================== END OF PAGE FILE MANAGMENT =============================
 
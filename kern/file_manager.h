@@ -9,21 +9,84 @@
 #define SECTOR_SIZE 512
 #define PAGE_FILE_START_SECTOR ((20 << 20) / SECTOR_SIZE) // start sector number of Page file in H.D.
 #define SECTOR_PER_PAGE (PAGE_SIZE / SECTOR_SIZE)
+#define MAX_SECTORS_PER_DISK_COMMAND (KERNEL_DISK_WINDOW_PAGES * SECTOR_PER_PAGE) // by the 48-bit LBA commands [see ide_start_command()]
 
 #define PAGE_FILE_SIZE (520 << 20) // page file size in MB
 #define PAGES_PER_FILE (PAGE_FILE_SIZE / PAGE_SIZE)
 
+// A page without a neighbor page in the page file is given the first frame of a free run of this size if there's
+// one, leaving room for the following pages [see allocate_disk_frame()]
+#define DISK_ALLOC_EXTENT_FRAMES 16
+
+// Lazy page-file allocation [when enabled]: the new pages of the heap [allocateMem()], of the stack and of the
+// zero-filled area of the program segments are only reserved in the page file: their disk page table entry is
+// DISK_PAGE_RESERVED instead of a disk frame. A fault on a reserved page maps a zeroed frame without reading the
+// disk, and the page is given its disk frame when it's first written back modified [a page evicted clean is
+// still all zeros]
+#define DISK_PAGE_RESERVED 0x80000000
+
+uint8 _PageFileLazyAllocation;
+
+struct Disk_Alloc_Stats
+{
+	uint32 numOfNeighborFrames;	 // next to the disk frame of the previous/next page
+	uint32 numOfRunFrames;		 // in a run for a range of pages
+	uint32 numOfScatteredFrames; // elsewhere
+	uint32 numOfReservedPages;	 // reserved without a disk frame [lazy page-file allocation]
+	uint32 numOfLazyFrames;		 // given to reserved pages at their first write-back
+	uint32 numOfZeroFilledPages; // faults on reserved pages
+};
+
+struct Disk_Alloc_Stats diskAllocStats;
+
+// Flushes of a buffer list by pf_update_modified_frames() [cycles of the TSC]
+struct Disk_Flush_Stats
+{
+	uint32 numOfFlushes;
+	uint32 numOfPages;
+	uint64 totalCycles;
+	uint32 lastNumOfPages; // of the last flush
+	uint64 lastCycles;
+};
+
+struct Disk_Flush_Stats diskFlushStats;
+
 ///=============================================================================================
 
+// A page to read/write from/to the page file by read_disk_pages()/write_disk_pages()
+struct Disk_Page
+{
+	uint32 dfn;
+	struct Frame_Info *frame;
+};
+
+int read_disk_pages(struct Disk_Page *pages, uint32 numOfPages);
+int write_disk_pages(struct Disk_Page *pages, uint32 numOfPages);
+
+int allocate_disk_frame(uint32 *dfn);
+int allocate_disk_frames(uint32 numOfFrames, uint32 *first_dfn);
+void free_disk_frame(uint32 dfn);
 int pf_add_empty_env_page(struct Env *ptr_env, uint32 virtual_address, uint8 initializeByZero);
+int pf_add_empty_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 numOfPages);
 int pf_update_env_page(struct Env *ptr_env, void *virtual_address, struct Frame_Info *modified_page_frame_info);
+void pf_update_modified_frames(struct Linked_List *ptr_frames_list);
 // int pf_special_update_env_modified_page(struct Env* ptr_env, uint32 virtual_address, struct Frame_Info* page_modified_frame_info);
 int pf_read_env_page(struct Env *ptr_env, void *virtual_address);
+int pf_read_env_page_async(struct Env *ptr_env, void *virtual_address);
+int pf_read_env_pages(struct Env *ptr_env, void *virtual_address, uint32 numOfPages);
+uint32 pf_count_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 maxNumOfPages);
 void pf_remove_env_page(struct Env *ptr_env, uint32 virtual_address);
 int pf_add_env_page(struct Env *ptr_env, uint32 virtual_address, void *dataSrc);
+int pf_add_env_pages(struct Env *ptr_env, uint32 virtual_address, void *dataSrc, uint32 numOfPages);
+int pf_reserve_env_pages(struct Env *ptr_env, uint32 virtual_address, uint32 numOfPages);
+uint8 pf_is_env_page_reserved(struct Env *ptr_env, uint32 virtual_address);
+
+void setPageFileLazyAllocation(uint8 enable);
+uint8 isPageFileLazyAllocation();
 ///=============================================================================================
 
 int pf_calculate_allocated_pages(struct Env *ptr_env);
 void pf_free_env(struct Env *ptr_env);
+void pf_print_statistics();
 void scarce_memory();
 #endif // FOS_KERN_FILE_MAN_H
@@ -0,0 +1,150 @@
+#include <inc/x86.h>
+#include <inc/stdio.h>
+#include <inc/disk.h>
+#include <inc/error.h>
+#include <kern/ide_dma.h>
+#include <kern/helpers.h>
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+#define PCI_COMMAND 0x04
+#define PCI_CLASS 0x08
+#define PCI_BAR4 0x20
+#define PCI_COMMAND_IO 0x01
+#define PCI_COMMAND_BUS_MASTER 0x04
+
+// Bus-master registers of the primary channel [at the I/O space of BAR4]
+#define BM_COMMAND 0
+#define BM_STATUS 2
+#define BM_PRDT 4
+#define BM_CMD_START 0x01
+#define BM_CMD_READ 0x08 // the controller writes to memory
+#define BM_STATUS_ACTIVE 0x01
+#define BM_STATUS_ERROR 0x02
+#define BM_STATUS_INTERRUPT 0x04
+
+#define IDE_CMD_READ_DMA 0xC8
+#define IDE_CMD_WRITE_DMA 0xCA
+
+// Physical region descriptor: a region shouldn't cross a 64 KB boundary [a frame never does]
+struct PRD
+{
+	uint32 physical_address;
+	uint16 numOfBytes;
+	uint16 flags;
+};
+#define PRD_EOT 0x8000 // last entry of the table
+
+// The table shouldn't cross a 64 KB boundary either: it's aligned on a page in the kernel image
+static struct PRD prdTable[IDE_DMA_MAX_PAGES] __attribute__((aligned(PAGE_SIZE)));
+static uint16 bmBase;
+static uint8 prdWrite;
+
+static uint32 pci_conf_read(uint32 bus, uint32 dev, uint32 func, uint32 offset)
+{
+	outl(PCI_CONFIG_ADDRESS, 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC));
+	return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_conf_write(uint32 bus, uint32 dev, uint32 func, uint32 offset, uint32 value)
+{
+	outl(PCI_CONFIG_ADDRESS, 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC));
+	outl(PCI_CONFIG_DATA, value);
+}
+
+// Find the bus-master IDE controller on PCI bus 0 and enable it. Return 0 if found
+static int ide_dma_init()
+{
+	if (bmBase != 0)
+		return 0;
+	for (uint32 dev = 0; dev < 32; dev++)
+	{
+		for (uint32 func = 0; func < 8; func++)
+		{
+			if ((pci_conf_read(0, dev, func, 0) & 0xFFFF) == 0xFFFF)
+				continue;
+			// class 01 [mass storage], subclass 01 [IDE], prog-if bit 7 [bus master]
+			uint32 class = pci_conf_read(0, dev, func, PCI_CLASS);
+			if ((class >> 16) != 0x0101 || !(class & 0x8000))
+				continue;
+			uint32 bar4 = pci_conf_read(0, dev, func, PCI_BAR4);
+			if (!(bar4 & 1))
+				continue;
+			pci_conf_write(0, dev, func, PCI_COMMAND, pci_conf_read(0, dev, func, PCI_COMMAND) | PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+			bmBase = bar4 & 0xFFFC;
+			cprintf("IDE bus-master DMA at PCI 00:%02x.%d, I/O port %x\n", dev, func, bmBase);
+			return 0;
+		}
+	}
+	return E_UNSPECIFIED;
+}
+
+// Enable DMA if the controller is there: return 0, or E_UNSPECIFIED [PIO is kept]
+int setDiskDMA(uint8 enable)
+{
+	if (enable && ide_dma_init() != 0)
+	{
+		_DiskDMAEnabled = 0;
+		return E_UNSPECIFIED;
+	}
+	_DiskDMAEnabled = enable;
+	return 0;
+}
+uint8 isDiskDMAEnabled() { return _DiskDMAEnabled; }
+
+// Start moving numOfPages pages between the disk from secno and the frames at the given physical addresses
+int ide_dma_start(uint32 secno, uint32 *physical_addresses, uint32 numOfPages, uint8 write)
+{
+	assert(bmBase != 0 && numOfPages > 0 && numOfPages <= IDE_DMA_MAX_PAGES);
+	for (uint32 i = 0; i < numOfPages; i++)
+	{
+		prdTable[i].physical_address = physical_addresses[i];
+		prdTable[i].numOfBytes = PAGE_SIZE;
+		prdTable[i].flags = (i == numOfPages - 1) ? PRD_EOT : 0;
+	}
+	prdWrite = write;
+
+	outl(bmBase + BM_PRDT, STATIC_KERNEL_PHYSICAL_ADDRESS(prdTable));
+	outb(bmBase + BM_COMMAND, write ? 0 : BM_CMD_READ);
+	outb(bmBase + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT); // write 1 to clear them
+	ide_start_command(secno, numOfPages * (PAGE_SIZE / SECTSIZE), write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA);
+	outb(bmBase + BM_COMMAND, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+	return 0;
+}
+
+// Return 1 if the transfer started by ide_dma_start() is still in progress, or its status when it's done
+int ide_dma_poll()
+{
+	uint8 status = inb(bmBase + BM_STATUS);
+	if ((status & BM_STATUS_ACTIVE) && !(status & (BM_STATUS_ERROR | BM_STATUS_INTERRUPT)))
+		return 1;
+
+	outb(bmBase + BM_COMMAND, prdWrite ? 0 : BM_CMD_READ);
+	outb(bmBase + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+	int r = ide_end_command();
+	if (status & BM_STATUS_ERROR)
+		return -1;
+	return r;
+}
+
+int ide_dma_transfer(uint32 secno, uint32 *physical_addresses, uint32 numOfPages, uint8 write)
+{
+	ide_dma_start(secno, physical_addresses, numOfPages, write);
+	int r;
+	while ((r = ide_dma_poll()) == 1)
+		/* do nothing */;
+	return r;
+}
+
+void ide_dma_print_statistics()
+{
+	cprintf("Page-file transfers by bus-master DMA: %s\n", isDiskDMAEnabled() ? "ENABLED" : "DISABLED");
+	char *names[] = {"PIO", "DMA"};
+	for (int path = DISK_PIO; path <= DISK_DMA; path++)
+	{
+		struct Disk_Transfer_Stats *stats = &diskTransferStats[path];
+		uint32 kb = (uint32)(stats->numOfBytes / 1024);
+		uint32 cyclesPerMB = (kb > 0) ? (uint32)(stats->totalCycles / kb) * 1024 : 0;
+		cprintf("	%s: commands = %d, KB = %d, cycles per MB = %u\n", names[path], stats->numOfCommands, kb, cyclesPerMB);
+	}
+}
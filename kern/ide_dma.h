@@ -0,0 +1,40 @@
+#ifndef FOS_KERN_IDE_DMA_H_
+#define FOS_KERN_IDE_DMA_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+
+// Bus-master DMA on the primary IDE channel of the PCI IDE controller [the PIIX one emulated by QEMU]:
+// the pages of a disk command are given to the controller by a physical region descriptor table (one entry
+// per frame) and it moves them between the disk and the frames without the CPU copying each sector by
+// insl/outsl. When it's enabled, the page-file transfers of whole pages [page reads, write-back, the
+// interrupt-driven reads of kern/disk_queue.c] use it; the other ones and a machine without the controller
+// use PIO.
+
+#define IDE_DMA_MAX_PAGES 256 // = MAX_SECTORS_PER_DISK_COMMAND sectors
+
+#define DISK_PIO 0
+#define DISK_DMA 1
+
+struct Disk_Transfer_Stats
+{
+	uint32 numOfCommands;
+	uint64 numOfBytes;
+	uint64 totalCycles;
+};
+
+uint8 _DiskDMAEnabled;
+struct Disk_Transfer_Stats diskTransferStats[DISK_DMA + 1]; // synchronous page-file transfers of each path
+
+int setDiskDMA(uint8 enable);
+uint8 isDiskDMAEnabled();
+
+int ide_dma_start(uint32 secno, uint32 *physical_addresses, uint32 numOfPages, uint8 write);
+int ide_dma_poll();
+int ide_dma_transfer(uint32 secno, uint32 *physical_addresses, uint32 numOfPages, uint8 write);
+void ide_dma_print_statistics();
+
+#endif // FOS_KERN_IDE_DMA_H_
@@ -8,6 +8,7 @@
 #include <kern/command_prompt.h>
 #include <kern/console.h>
 #include <kern/memory_manager.h>
+#include <kern/kheap.h>
 #include <kern/helpers.h>
 #include <kern/kclock.h>
 #include <kern/user_environment.h>
@@ -50,6 +51,7 @@ void FOS_initialize()
 	detect_memory();
 	initialize_kernel_VM();
 	initialize_paging();
+	initialize_kheap();
 	//	page_check();
 
 	// Lab 3 user environment initialization functions
@@ -61,7 +61,7 @@ void kclock_start(uint8 quantum_in_ms)
 	//	uint16 cnt0_after = kclock_read_cnt0() ;
 
 	// cprintf("	Setup timer interrupts via 8259A\n");
-	irq_setmask_8259A(irq_mask_8259A & ~(1 << 0));
+	irq_setmask_8259A(irq_mask_8259A & ~(1 << 0) & ~irq_devices_8259A);
 	// cprintf("	unmasked timer interrupt\n");
 
 	// cprintf("Timer STARTED: Counter0 Before Lag = %d, After lag = %d\n", cnt0_before, cnt0_after );
@@ -154,7 +154,7 @@ void kclock_resume(void)
 	//	cprintf("Timer RESUMED: Counter0 Before Lag = %d, After lag = %d\n", cnt0_before, cnt0_after );
 
 	// cprintf("	Setup timer interrupts via 8259A\n");
-	irq_setmask_8259A(irq_mask_8259A & ~(1 << 0));
+	irq_setmask_8259A(irq_mask_8259A & ~(1 << 0) & ~irq_devices_8259A);
 	// cprintf("	unmasked timer interrupt\n");
 }
 
@@ -164,7 +164,7 @@ void kclock_start_counter(uint8 cnt0)
 {
 	outb(TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT);
 	kclock_write_cnt0_LSB_first(cnt0);
-	irq_setmask_8259A(irq_mask_8259A & ~(1 << 0));
+	irq_setmask_8259A(irq_mask_8259A & ~(1 << 0) & ~irq_devices_8259A);
 }
 // 2018
 // Reset the CNT0 to the given quantum value without affecting the interrupt status
@@ -1,25 +1,479 @@
 #include <inc/memlayout.h>
+#include <inc/x86.h>
 #include <kern/kheap.h>
 #include <kern/memory_manager.h>
 
 // NOTE: All kernel heap allocations are multiples of PAGE_SIZE (4KB)
 
-// Array to keep track of allocated pages in kernel heap ( 0=free , 1=allocated )
-unsigned int numOfPages[(KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE] = {0};
+#define KHEAP_NUM_PAGES ((KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE)
+#define KHEAP_NIL (-1)
+
+// Free extents of the kernel heap are kept in an address-ordered treap (a randomized balanced BST)
+// Each node is stored at the index of the first page of its extent, so no extra memory is needed
+// to allocate tree nodes. Every node also keeps the largest extent size found in its subtree,
+// which lets kmalloc() locate the lowest-addressed fitting extent in O(log n).
+// The same nodes are linked in a second treap ordered by (size, address), used by BEST/WORST FIT.
+struct KHeap_Extent
+{
+	int left;
+	int right;
+	int sizeLeft;
+	int sizeRight;
+	uint32 priority;
+	unsigned int size;	  // Number of free pages in the extent that starts at this page (0 = not an extent start)
+	unsigned int maxSize; // Largest extent size in the subtree rooted at this node
+} kheapExtents[KHEAP_NUM_PAGES];
+
+// Boundary tag: number of free pages in the extent that ENDS at this page (0 = not an extent end)
+// used to find the left neighbour of a freed block in O(1)
+unsigned int kheapExtentTail[KHEAP_NUM_PAGES];
+
+int kheapExtentsRoot = KHEAP_NIL;
+int kheapSizeRoot = KHEAP_NIL;
+uint32 kheapRandSeed = 2463534242u;
+
+unsigned int kheapNumOfFreeExtents = 0;
+unsigned int kheapNumOfFreePages = 0;
+
+// Page at which the last allocation ended (NEXT FIT) and the highest page ever allocated (CONTALLOC)
+int kheapNextFitPage = 0;
+int kheapBreakPage = 0;
+
+// Per-strategy statistics, indexed by KHP_PLACE_XXX
+struct KHeap_Strategy_Stats
+{
+	uint32 numOfAllocs;
+	uint32 numOfFailures;
+	uint64 totalCycles;
+} kheapStrategyStats[KHP_PLACE_WORSTFIT + 1];
 
 unsigned int NumOfNeededPages; // Number of pages needed for the requested memory allocation
 
-struct Frame_Info *ptr_frame_info;
+// Per-page allocation metadata, indexed by (va - KERNEL_HEAP_START) >> PGSHIFT
+struct Kernel_Heap_info // to keep track of the data of the block allocated made by kmalloc()
+{
+	int blockStart;			 // First page of the allocated block that holds this page (KHEAP_NIL = free page)
+	int numOfAllocatedPages; // Valid at the first page of the block only
+	unsigned int size;		 // Requested size in bytes, valid at the first page of the block only
+} kheapPagesInfo[KHEAP_NUM_PAGES];
 
-int NextAllocIndex = 0;
+//==================================================================================//
+//============================== FREE EXTENTS INDEX ================================//
+//==================================================================================//
 
-struct Kernel_Heap_info // to keep track of the data of the block allocated made by kmalloc()
+static uint32 kheap_next_priority()
+{
+	// xorshift32
+	kheapRandSeed ^= kheapRandSeed << 13;
+	kheapRandSeed ^= kheapRandSeed >> 17;
+	kheapRandSeed ^= kheapRandSeed << 5;
+	return kheapRandSeed;
+}
+
+static inline unsigned int kheap_max_size(int node)
+{
+	return (node == KHEAP_NIL) ? 0 : kheapExtents[node].maxSize;
+}
+
+static void kheap_update_node(int node)
+{
+	unsigned int maxSize = kheapExtents[node].size;
+	if (kheap_max_size(kheapExtents[node].left) > maxSize)
+		maxSize = kheap_max_size(kheapExtents[node].left);
+	if (kheap_max_size(kheapExtents[node].right) > maxSize)
+		maxSize = kheap_max_size(kheapExtents[node].right);
+	kheapExtents[node].maxSize = maxSize;
+}
+
+// Split the tree rooted at "node" into nodes with index < key (*left) and index >= key (*right)
+static void kheap_split(int node, int key, int *left, int *right)
+{
+	if (node == KHEAP_NIL)
+	{
+		*left = *right = KHEAP_NIL;
+		return;
+	}
+	if (node < key)
+	{
+		kheap_split(kheapExtents[node].right, key, &kheapExtents[node].right, right);
+		*left = node;
+	}
+	else
+	{
+		kheap_split(kheapExtents[node].left, key, left, &kheapExtents[node].left);
+		*right = node;
+	}
+	kheap_update_node(node);
+}
+
+// Merge two trees where all the indices of "left" are less than all the indices of "right"
+static int kheap_merge(int left, int right)
+{
+	if (left == KHEAP_NIL)
+		return right;
+	if (right == KHEAP_NIL)
+		return left;
+	if (kheapExtents[left].priority > kheapExtents[right].priority)
+	{
+		kheapExtents[left].right = kheap_merge(kheapExtents[left].right, right);
+		kheap_update_node(left);
+		return left;
+	}
+	kheapExtents[right].left = kheap_merge(left, kheapExtents[right].left);
+	kheap_update_node(right);
+	return right;
+}
+
+// Is extent "node" ordered before the key (size, startPage) in the size-ordered treap?
+static inline int kheap_size_less(int node, unsigned int size, int startPage)
+{
+	if (kheapExtents[node].size != size)
+		return kheapExtents[node].size < size;
+	return node < startPage;
+}
+
+// Same as kheap_split() but over the size-ordered treap
+static void kheap_size_split(int node, unsigned int size, int startPage, int *left, int *right)
+{
+	if (node == KHEAP_NIL)
+	{
+		*left = *right = KHEAP_NIL;
+		return;
+	}
+	if (kheap_size_less(node, size, startPage))
+	{
+		kheap_size_split(kheapExtents[node].sizeRight, size, startPage, &kheapExtents[node].sizeRight, right);
+		*left = node;
+	}
+	else
+	{
+		kheap_size_split(kheapExtents[node].sizeLeft, size, startPage, left, &kheapExtents[node].sizeLeft);
+		*right = node;
+	}
+}
+
+static int kheap_size_merge(int left, int right)
+{
+	if (left == KHEAP_NIL)
+		return right;
+	if (right == KHEAP_NIL)
+		return left;
+	if (kheapExtents[left].priority > kheapExtents[right].priority)
+	{
+		kheapExtents[left].sizeRight = kheap_size_merge(kheapExtents[left].sizeRight, right);
+		return left;
+	}
+	kheapExtents[right].sizeLeft = kheap_size_merge(left, kheapExtents[right].sizeLeft);
+	return right;
+}
+
+// Add the free extent [startPage, startPage + numOfPages) to the index
+static void kheap_insert_extent(int startPage, unsigned int numOfPages)
+{
+	struct KHeap_Extent *ext = &kheapExtents[startPage];
+	ext->left = ext->right = KHEAP_NIL;
+	ext->sizeLeft = ext->sizeRight = KHEAP_NIL;
+	ext->priority = kheap_next_priority();
+	ext->size = ext->maxSize = numOfPages;
+	kheapExtentTail[startPage + numOfPages - 1] = numOfPages;
+
+	int left, right;
+	kheap_split(kheapExtentsRoot, startPage, &left, &right);
+	kheapExtentsRoot = kheap_merge(kheap_merge(left, startPage), right);
+
+	kheap_size_split(kheapSizeRoot, numOfPages, startPage, &left, &right);
+	kheapSizeRoot = kheap_size_merge(kheap_size_merge(left, startPage), right);
+
+	kheapNumOfFreeExtents++;
+	kheapNumOfFreePages += numOfPages;
+}
+
+// Remove the free extent starting at startPage from the index
+static void kheap_remove_extent(int startPage)
+{
+	unsigned int size = kheapExtents[startPage].size;
+	int left, middle, right;
+	kheap_split(kheapExtentsRoot, startPage, &left, &right);
+	kheap_split(right, startPage + 1, &middle, &right);
+	kheapExtentsRoot = kheap_merge(left, right);
+
+	kheap_size_split(kheapSizeRoot, size, startPage, &left, &right);
+	kheap_size_split(right, size, startPage + 1, &middle, &right);
+	kheapSizeRoot = kheap_size_merge(left, right);
+
+	kheapExtentTail[startPage + size - 1] = 0;
+	kheapExtents[startPage].size = kheapExtents[startPage].maxSize = 0;
+
+	kheapNumOfFreeExtents--;
+	kheapNumOfFreePages -= size;
+}
+
+// Return the start page of the lowest-addressed free extent with at least numOfPages pages, or KHEAP_NIL
+static int kheap_find_first_fit(unsigned int numOfPages)
+{
+	int node = kheapExtentsRoot;
+	if (kheap_max_size(node) < numOfPages)
+		return KHEAP_NIL;
+	while (node != KHEAP_NIL)
+	{
+		if (kheap_max_size(kheapExtents[node].left) >= numOfPages)
+			node = kheapExtents[node].left;
+		else if (kheapExtents[node].size >= numOfPages)
+			return node;
+		else
+			node = kheapExtents[node].right;
+	}
+	return KHEAP_NIL;
+}
+
+// Return the start page of the lowest-addressed free extent that starts at or after
+// minPage and has at least numOfPages pages, or KHEAP_NIL
+static int kheap_find_fit_from(int node, int minPage, unsigned int numOfPages)
+{
+	while (node != KHEAP_NIL && node < minPage)
+		node = kheapExtents[node].right;
+	if (node == KHEAP_NIL || kheap_max_size(node) < numOfPages)
+		return KHEAP_NIL;
+
+	int found = kheap_find_fit_from(kheapExtents[node].left, minPage, numOfPages);
+	if (found != KHEAP_NIL)
+		return found;
+	if (kheapExtents[node].size >= numOfPages)
+		return node;
+	return kheap_find_fit_from(kheapExtents[node].right, minPage, numOfPages);
+}
+
+// Return the start page of the free extent that contains the given page, or KHEAP_NIL
+static int kheap_find_extent_containing(int page)
+{
+	int node = kheapExtentsRoot;
+	int candidate = KHEAP_NIL;
+	while (node != KHEAP_NIL)
+	{
+		if (node <= page)
+		{
+			candidate = node;
+			node = kheapExtents[node].right;
+		}
+		else
+			node = kheapExtents[node].left;
+	}
+	if (candidate != KHEAP_NIL && candidate + kheapExtents[candidate].size > page)
+		return candidate;
+	return KHEAP_NIL;
+}
+
+// Return the start page of the smallest free extent with at least numOfPages pages
+// (lowest address among equal sizes), or KHEAP_NIL
+static int kheap_find_smallest_fit(unsigned int numOfPages)
+{
+	int node = kheapSizeRoot;
+	int candidate = KHEAP_NIL;
+	while (node != KHEAP_NIL)
+	{
+		if (kheapExtents[node].size >= numOfPages)
+		{
+			candidate = node;
+			node = kheapExtents[node].sizeLeft;
+		}
+		else
+			node = kheapExtents[node].sizeRight;
+	}
+	return candidate;
+}
+
+// Take numOfPages pages starting at "page" from the free extent that starts at extentStart
+static void kheap_take_pages(int extentStart, int page, unsigned int numOfPages)
+{
+	unsigned int extentSize = kheapExtents[extentStart].size;
+	kheap_remove_extent(extentStart);
+	if (page > extentStart)
+		kheap_insert_extent(extentStart, page - extentStart);
+	if (extentStart + extentSize > page + numOfPages)
+		kheap_insert_extent(page + numOfPages, extentStart + extentSize - (page + numOfPages));
+}
+
+// Return the pages [startPage, startPage + numOfPages) to the index, coalescing them with the free neighbours
+static void kheap_release_pages(int startPage, unsigned int numOfPages)
+{
+	// coalesce with the previous free extent (if any)
+	if (startPage > 0 && kheapExtentTail[startPage - 1] != 0)
+	{
+		int prevStart = startPage - kheapExtentTail[startPage - 1];
+		numOfPages += kheapExtents[prevStart].size;
+		kheap_remove_extent(prevStart);
+		startPage = prevStart;
+	}
+	// coalesce with the next free extent (if any)
+	int nextStart = startPage + numOfPages;
+	if (nextStart < KHEAP_NUM_PAGES && kheapExtents[nextStart].size != 0)
+	{
+		numOfPages += kheapExtents[nextStart].size;
+		kheap_remove_extent(nextStart);
+	}
+	kheap_insert_extent(startPage, numOfPages);
+}
+
+//==================================================================================//
+//============================== PLACEMENT ENGINES =================================//
+//==================================================================================//
+// Each engine returns the first page of the block to allocate (or KHEAP_NIL) and sets
+// *extentStart to the start page of the free extent that holds it
+
+static int kheap_place_contalloc(unsigned int numOfPages, int *extentStart)
+{
+	// Continue right after the highest allocated page, never reusing freed space below it
+	*extentStart = kheap_find_extent_containing(kheapBreakPage);
+	if (*extentStart == KHEAP_NIL || *extentStart + kheapExtents[*extentStart].size < kheapBreakPage + numOfPages)
+		return KHEAP_NIL;
+	return kheapBreakPage;
+}
+
+static int kheap_place_firstfit(unsigned int numOfPages, int *extentStart)
+{
+	*extentStart = kheap_find_first_fit(numOfPages);
+	return *extentStart;
+}
+
+static int kheap_place_bestfit(unsigned int numOfPages, int *extentStart)
+{
+	*extentStart = kheap_find_smallest_fit(numOfPages);
+	return *extentStart;
+}
+
+static int kheap_place_nextfit(unsigned int numOfPages, int *extentStart)
+{
+	int page = (kheapNextFitPage < KHEAP_NUM_PAGES) ? kheapNextFitPage : 0;
+
+	// Continue inside the free extent that holds the NEXT FIT pointer (if any)...
+	*extentStart = kheap_find_extent_containing(page);
+	if (*extentStart != KHEAP_NIL && *extentStart + kheapExtents[*extentStart].size >= page + numOfPages)
+		return page;
+
+	// ...else take the first fitting extent after it, looping back to the heap start if none
+	*extentStart = kheap_find_fit_from(kheapExtentsRoot, page + 1, numOfPages);
+	if (*extentStart == KHEAP_NIL)
+		*extentStart = kheap_find_first_fit(numOfPages);
+	return *extentStart;
+}
+
+static int kheap_place_worstfit(unsigned int numOfPages, int *extentStart)
+{
+	unsigned int largest = kheap_max_size(kheapExtentsRoot);
+	if (largest < numOfPages)
+		return *extentStart = KHEAP_NIL;
+	*extentStart = kheap_find_smallest_fit(largest);
+	return *extentStart;
+}
+
+int (*kheapPlacementEngines[])(unsigned int numOfPages, int *extentStart) =
+	{
+		[KHP_PLACE_CONTALLOC] = kheap_place_contalloc,
+		[KHP_PLACE_FIRSTFIT] = kheap_place_firstfit,
+		[KHP_PLACE_BESTFIT] = kheap_place_bestfit,
+		[KHP_PLACE_NEXTFIT] = kheap_place_nextfit,
+		[KHP_PLACE_WORSTFIT] = kheap_place_worstfit,
+};
+
+//==================================================================================//
+//============================ PER-PAGE BLOCK METADATA =============================//
+//==================================================================================//
+
+// Record [startPage, startPage + numOfPages) as owned by the block that starts at blockStart (KHEAP_NIL = free)
+static void kheap_set_block_pages(int startPage, unsigned int numOfPages, int blockStart)
+{
+	for (int i = 0; i < numOfPages; i++)
+		kheapPagesInfo[startPage + i].blockStart = blockStart;
+}
+
+// Return the first page of the allocated block that holds the given address, or KHEAP_NIL
+static int kheap_block_of(uint32 virtual_address)
+{
+	if (virtual_address < KERNEL_HEAP_START || virtual_address >= KERNEL_HEAP_START + KHEAP_NUM_PAGES * PAGE_SIZE)
+		return KHEAP_NIL;
+	return kheapPagesInfo[(virtual_address - KERNEL_HEAP_START) >> PGSHIFT].blockStart;
+}
+
+void initialize_kheap()
+{
+	kheapExtentsRoot = kheapSizeRoot = KHEAP_NIL;
+	kheap_insert_extent(0, KHEAP_NUM_PAGES);
+	kheap_set_block_pages(0, KHEAP_NUM_PAGES, KHEAP_NIL);
+}
+
+void kheap_print_statistics()
+{
+	char *names[] = {"CONTALLOC", "FIRST FIT", "BEST FIT", "NEXT FIT", "WORST FIT"};
+	unsigned int largest = kheap_max_size(kheapExtentsRoot);
+
+	cprintf("Kernel heap: free pages = %d, free extents = %d, largest extent = %d pages\n",
+			kheapNumOfFreePages, kheapNumOfFreeExtents, largest);
+	if (kheapNumOfFreePages > 0)
+		cprintf("External fragmentation = %d%%\n", 100 - (largest * 100) / kheapNumOfFreePages);
+	for (int i = 0; i <= KHP_PLACE_WORSTFIT; i++)
+	{
+		struct KHeap_Strategy_Stats *stats = &kheapStrategyStats[i];
+		uint32 avgCycles = (stats->numOfAllocs > 0) ? (uint32)(stats->totalCycles / stats->numOfAllocs) : 0;
+		cprintf("%s:\tallocs = %d, failures = %d, avg. cycles/alloc = %d\n",
+				names[i], stats->numOfAllocs, stats->numOfFailures, avgCycles);
+	}
+}
+
+//==================================================================================//
+//================================ KERNEL HEAP =====================================//
+//==================================================================================//
+
+// Reserve numOfPages contiguous pages using the current placement strategy.
+// Return the first page of the block, or KHEAP_NIL if there is no suitable free extent
+static int kheap_place_block(unsigned int numOfPages)
 {
-	int FirstIndex;
-	uint32 FirstVA;
-	int numOfAllocatedPages;
-	unsigned int size;
-} AllocatedBlock[(KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE] = {0};
+	// Ask the current placement engine for a block of free pages
+	uint32 strategy = (_KHeapPlacementStrategy <= KHP_PLACE_WORSTFIT) ? _KHeapPlacementStrategy : KHP_PLACE_FIRSTFIT;
+	uint64 startCycles = read_tsc();
+	int extentStart;
+	int startPage = kheapPlacementEngines[strategy](numOfPages, &extentStart);
+	if (startPage == KHEAP_NIL)
+	{
+		kheapStrategyStats[strategy].numOfFailures++;
+		return KHEAP_NIL;
+	}
+	kheap_take_pages(extentStart, startPage, numOfPages);
+	kheapStrategyStats[strategy].numOfAllocs++;
+	kheapStrategyStats[strategy].totalCycles += read_tsc() - startCycles;
+
+	kheapNextFitPage = startPage + numOfPages;
+	if (kheapNextFitPage > kheapBreakPage)
+		kheapBreakPage = kheapNextFitPage;
+	return startPage;
+}
+
+// Allocate and map a new frame for each page in [startPage, startPage + numOfPages).
+// Either all the pages are mapped or none of them (returns E_NO_MEM)
+static int kheap_map_new_frames(int startPage, unsigned int numOfPages)
+{
+	uint32 virtual_address = KERNEL_HEAP_START + startPage * PAGE_SIZE;
+	struct Linked_List frames;
+	LIST_INIT(&frames);
+	if (allocate_frames(numOfPages, &frames) == E_NO_MEM)
+	{
+		cprintf("No enough memory for page itself!\n");
+		return E_NO_MEM;
+	}
+	// reverse map for kheap_virtual_address()
+	uint32 frame_va = virtual_address;
+	struct Frame_Info *ptr_fi;
+	LIST_FOREACH(ptr_fi, &frames)
+	{
+		ptr_fi->kheap_va = frame_va;
+		frame_va += PAGE_SIZE;
+	}
+	if (map_frame_range(ptr_page_directory, &frames, (void *)virtual_address, numOfPages, PERM_PRESENT | PERM_WRITEABLE) == E_NO_MEM)
+	{
+		free_frames(&frames);
+		return E_NO_MEM;
+	}
+	return 0;
+}
 
 void *kmalloc(unsigned int size)
 {
@@ -27,78 +481,36 @@ void *kmalloc(unsigned int size)
 	//  Write your code here, remove the panic and write your code
 	// kpanic_into_prompt("kmalloc() is not implemented yet...!!");
 
-	uint32 virtual_address = KERNEL_HEAP_START;
-	int contiguousFreePages = 0; // Counter to keep track of the number of consecutive free pages in the kernel heap
-
 	if (size > (KERNEL_HEAP_MAX - KERNEL_HEAP_START) || size <= 0) // Check if the size is within the range of the kernel heap
 	{
 		cprintf("Invalid Size!\n");
 		return NULL;
 	}
 	// Calculate the number of pages required for the allocation
-	if (size % PAGE_SIZE == 0)
-	{
-		NumOfNeededPages = size / PAGE_SIZE;
-	}
-	else if (size % PAGE_SIZE != 0)
+	NumOfNeededPages = ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE;
+
+	int startPage = kheap_place_block(NumOfNeededPages);
+	if (startPage == KHEAP_NIL)
 	{
-		NumOfNeededPages = (size / PAGE_SIZE) + 1;
+		// If we get here, there is not enough contiguous free pages
+		return NULL;
 	}
-	// Loop through the heap pages to find a block of free pages to allocate
-	for (int j = 0; j < ((KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE); j++)
+	if (kheap_map_new_frames(startPage, NumOfNeededPages) == E_NO_MEM)
 	{
-		if (NextAllocIndex >= ((KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE))
-		{ // Check if there is enough space in the AllocatedBlock array
-			cprintf("Kernel heap is full!\n");
-			return NULL;
-		}
-		// Check if the current page is free or allocated
-		if (numOfPages[j] == 0)
-		{ // A free page is found , add it to the counter
-			contiguousFreePages++;
-		}
-		else
-		{ // Interrupted by an allocated page , reset the counter
-			contiguousFreePages = 0;
-		}
-		if (contiguousFreePages == NumOfNeededPages)
-		{																					// Found a block of free pages, allocate them
-			virtual_address = KERNEL_HEAP_START + ((j - NumOfNeededPages + 1) * PAGE_SIZE);    // 1st VA to be allocated
-			for (int i = 0; i < NumOfNeededPages; i++)
-			{
-				int ret = allocate_frame(&ptr_frame_info);
-				if (ret == E_NO_MEM)
-				{
-					cprintf("No enough memory for page itself!\n");
-					return NULL;
-				}
-				ret = map_frame(ptr_page_directory, ptr_frame_info, (void *)(virtual_address + (i * PAGE_SIZE)), PERM_PRESENT | PERM_WRITEABLE);
-				if (ret == E_NO_MEM)
-				{
-					cprintf("No enough memory for page table!\n");
-					free_frame(ptr_frame_info);
-					return NULL;
-				}
-				numOfPages[j - NumOfNeededPages + 1 + i] = 1; // Mark the page as allocated in the numOfPages array
-			}
-			// Update the AllocatedBlock entry
-			AllocatedBlock[NextAllocIndex].FirstIndex = (j - NumOfNeededPages + 1);
-			AllocatedBlock[NextAllocIndex].FirstVA = virtual_address;
-			AllocatedBlock[NextAllocIndex].numOfAllocatedPages = NumOfNeededPages;
-			AllocatedBlock[NextAllocIndex].size = size;
-			NextAllocIndex++;
-			return (void *)virtual_address;
-		}
+		// Give the extent back
+		kheap_release_pages(startPage, NumOfNeededPages);
+		return NULL;
 	}
-	// If we get here, there is not enough contiguous free pages
-	return NULL;
 
-	// NOTE: Allocation is based on FIRST FIT strategy
+	// Record the block in the metadata of its pages
+	kheap_set_block_pages(startPage, NumOfNeededPages, startPage);
+	kheapPagesInfo[startPage].numOfAllocatedPages = NumOfNeededPages;
+	kheapPagesInfo[startPage].size = size;
+	return (void *)(KERNEL_HEAP_START + startPage * PAGE_SIZE); // 1st VA of the allocated block
+
+	// NOTE: Allocation is based on the strategy selected in _KHeapPlacementStrategy
 	// NOTE: All kernel heap allocations are multiples of PAGE_SIZE (4KB)
 	// refer to the project presentation and documentation for details
-
-	// change this "return" according to your answer
-	// return NULL;
 }
 
 void kfree(void *virtual_address)
@@ -106,46 +518,34 @@ void kfree(void *virtual_address)
 	// TODO: [PROJECT 2023 - MS1 - [1] Kernel Heap] kfree()
 
 	uint32 VA = (uint32)virtual_address;
-	int startIndex = -1;
-	int index = -1;
 
-	if (VA < KERNEL_HEAP_START || VA > KERNEL_HEAP_MAX || virtual_address == NULL)
+	if (VA < KERNEL_HEAP_START || VA >= KERNEL_HEAP_MAX || virtual_address == NULL)
 	{
 		// The given virtual address is not within the range of the kernel heap.
 		cprintf("Invalid Virtual Address!\n");
 		return;
 	}
 
-	// Check if virtual address is within the range of the allocated block
-	for (int i = 0; i < (KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE; i++)
-	{
-		if (virtual_address >= (void *)AllocatedBlock[i].FirstVA &&
-			virtual_address < (void *)(AllocatedBlock[i].FirstVA + (AllocatedBlock[i].numOfAllocatedPages * PAGE_SIZE)))
-		{
-			startIndex = AllocatedBlock[i].FirstIndex;
-			index = i;
-			break;
-		}
-	}
-
-	if (startIndex == -1)
+	// Find the block that holds the virtual address from the metadata of its page
+	int startIndex = kheap_block_of(VA);
+	if (startIndex == KHEAP_NIL)
 	{
 		// The given virtual address is not in a valid allocated block
 		return;
 	}
+	int numOfAllocatedPages = kheapPagesInfo[startIndex].numOfAllocatedPages;
+	uint32 blockVA = KERNEL_HEAP_START + startIndex * PAGE_SIZE;
 
 	// Free the pages allocated to the block
-	for (int i = 0; i < AllocatedBlock[index].numOfAllocatedPages; i++)
+	for (int i = 0; i < numOfAllocatedPages; i++)
 	{
-		numOfPages[startIndex + i] = 0;
-		unmap_frame(ptr_page_directory, (void *)(AllocatedBlock[index].FirstVA + (i * PAGE_SIZE)));
+		unmap_frame(ptr_page_directory, (void *)(blockVA + (i * PAGE_SIZE)));
 	}
-
-	// Clear the AllocatedBlock entry
-	AllocatedBlock[index].FirstIndex = -1;
-	AllocatedBlock[index].FirstVA = 0;
-	AllocatedBlock[index].numOfAllocatedPages = 0;
-	AllocatedBlock[index].size = 0;
+	// Clear the block metadata and give the pages back to the free extents index (coalescing with the neighbours)
+	kheap_set_block_pages(startIndex, numOfAllocatedPages, KHEAP_NIL);
+	kheapPagesInfo[startIndex].numOfAllocatedPages = 0;
+	kheapPagesInfo[startIndex].size = 0;
+	kheap_release_pages(startIndex, numOfAllocatedPages);
 
 	// you need to get the size of the given allocation using its address
 	// refer to the project presentation and documentation for details
@@ -157,39 +557,78 @@ unsigned int kheap_virtual_address(unsigned int physical_address)
 	//  Write your code here, remove the panic and write your code
 	// panic("kheap_virtual_address() is not implemented yet...!!");
 
+	numOfKheapVACalls++;
+
+	// The frame keeps the kernel heap VA it's mapped to (set by kmalloc, cleared when the frame is freed)
+	if (PPN(physical_address) >= number_of_frames)
+		return 0;
+	return to_frame_info(physical_address)->kheap_va;
+
+	// return the virtual address corresponding to given physical_address
+	// refer to the project presentation and documentation for details
+}
+
+// The original kheap_virtual_address(): walks the kernel heap pages until the physical address matches.
+// Kept only as a baseline for kheap_virtual_address_benchmark()
+static unsigned int kheap_virtual_address_by_scan(unsigned int physical_address)
+{
 	// Round down the physical address to the nearest page boundary
 	physical_address = ROUNDDOWN(physical_address, PAGE_SIZE);
 
 	// Check each virtual address in the kernel heap
-	for (int i = 0; i < ((KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE); i++)
+	for (int i = 0; i < KHEAP_NUM_PAGES; i++)
 	{
 		unsigned int virtual_address = KERNEL_HEAP_START + (i * PAGE_SIZE);
 
 		uint32 *ptr_table = NULL;
 		struct Frame_Info *ptr_frame_info = get_frame_info(ptr_page_directory, (void *)virtual_address, &ptr_table);
 
-		if (ptr_frame_info != NULL)
-		{
-			unsigned int physaddrtobecompared = to_physical_address(ptr_frame_info);
-
-			if (physaddrtobecompared == physical_address)
-			{
-				// Return the virtual address corresponding to the given physical address
-				return virtual_address;
-			}
-		}
+		if (ptr_frame_info != NULL && to_physical_address(ptr_frame_info) == physical_address)
+			return virtual_address;
 	}
-
-	// If the physical address is not mapped to any virtual address in the kernel heap, return 0
 	return 0;
+}
 
-	// return the virtual address corresponding to given physical_address
-	// refer to the project presentation and documentation for details
-
-	// change this "return" according to your answer
+// Time the reverse lookup of the first numOfPages kernel heap pages using both the scan and the reverse map,
+// then estimate the cycles saved over the kheap_virtual_address() calls of the last run program
+void kheap_virtual_address_benchmark(uint32 numOfPages)
+{
+	uint64 scanCycles = 0, mapCycles = 0;
+	uint32 numOfLookups = 0;
+	for (int i = 0; i < KHEAP_NUM_PAGES && numOfLookups < numOfPages; i++)
+	{
+		unsigned int physical_address = kheap_physical_address(KERNEL_HEAP_START + i * PAGE_SIZE);
+		if (physical_address == 0)
+			continue;
+
+		uint64 t0 = read_tsc();
+		unsigned int scanVA = kheap_virtual_address_by_scan(physical_address);
+		uint64 t1 = read_tsc();
+		unsigned int mapVA = to_frame_info(physical_address)->kheap_va;
+		uint64 t2 = read_tsc();
+
+		if (scanVA != mapVA)
+			panic("kheap_virtual_address_benchmark: reverse map of PA %x is %x, expected %x", physical_address, mapVA, scanVA);
+		scanCycles += t1 - t0;
+		mapCycles += t2 - t1;
+		numOfLookups++;
+	}
+	if (numOfLookups == 0)
+	{
+		cprintf("No kernel heap pages to look up!\n");
+		return;
+	}
 
-	// return 0;
-}	
+	uint32 scanAvg = (uint32)(scanCycles / numOfLookups);
+	uint32 mapAvg = (uint32)(mapCycles / numOfLookups);
+	cprintf("kheap_virtual_address over %d kernel heap pages:\n", numOfLookups);
+	cprintf("\tscan        : %d cycles/lookup\n", scanAvg);
+	cprintf("\treverse map : %d cycles/lookup\n", mapAvg);
+	if (mapAvg > 0)
+		cprintf("\tspeed-up    : %dx\n", scanAvg / mapAvg);
+	cprintf("Num of calls for kheap_virtual_address [in last run] = %d => ~%d Mcycles saved\n",
+			numOfKheapVACalls, (uint32)(((uint64)numOfKheapVACalls * (scanAvg - mapAvg)) / 1000000));
+}
 
 unsigned int kheap_physical_address(unsigned int virtual_address)
 {
@@ -237,12 +676,8 @@ unsigned int kheap_physical_address(unsigned int virtual_address)
 //	A call with new_size = zero is equivalent to kfree().
 
 
-// krealloc is NOT COMPLETELY WORKING YET! Current Evaluation = 30%
 void *krealloc(void *virtual_address, uint32 new_size)
 {
-	// panic("krealloc() is not implemented yet...!!");
-	// return NULL;
-	int index = -1;
 	if (virtual_address == NULL && new_size != 0)
 	{
 		return kmalloc(new_size);
@@ -256,29 +691,112 @@ void *krealloc(void *virtual_address, uint32 new_size)
 	{
 		return NULL;
 	}
-	// Check if virtual address is within the range of the allocated block
-	for (int i = 0; i < (KERNEL_HEAP_MAX - KERNEL_HEAP_START) / PAGE_SIZE; i++)
+	if (new_size > (KERNEL_HEAP_MAX - KERNEL_HEAP_START))
+	{
+		cprintf("Invalid Size!\n");
+		return NULL;
+	}
+	// Find the block that holds the virtual address from the metadata of its page
+	int startPage = kheap_block_of((uint32)virtual_address);
+	if (startPage == KHEAP_NIL)
+	{
+		// The given virtual address is not in a valid allocated block
+		return NULL;
+	}
+	uint32 blockVA = KERNEL_HEAP_START + startPage * PAGE_SIZE;
+	unsigned int oldNumOfPages = kheapPagesInfo[startPage].numOfAllocatedPages;
+	unsigned int newNumOfPages = ROUNDUP(new_size, PAGE_SIZE) / PAGE_SIZE;
+
+	//[1] Same number of pages: nothing to move
+	if (newNumOfPages == oldNumOfPages)
+	{
+		kheapPagesInfo[startPage].size = new_size;
+		return (void *)blockVA;
+	}
+
+	//[2] Shrink: give the tail pages back to the heap (coalescing with the free space after the block)
+	if (newNumOfPages < oldNumOfPages)
+	{
+		int tailPage = startPage + newNumOfPages;
+		unsigned int numOfTailPages = oldNumOfPages - newNumOfPages;
+		for (int i = 0; i < numOfTailPages; i++)
+			unmap_frame(ptr_page_directory, (void *)(blockVA + (newNumOfPages + i) * PAGE_SIZE));
+		kheap_set_block_pages(tailPage, numOfTailPages, KHEAP_NIL);
+		kheap_release_pages(tailPage, numOfTailPages);
+
+		kheapPagesInfo[startPage].numOfAllocatedPages = newNumOfPages;
+		kheapPagesInfo[startPage].size = new_size;
+		return (void *)blockVA;
+	}
+
+	//[3] Grow in place: extend into the free extent right after the block (if it's large enough)
+	int nextPage = startPage + oldNumOfPages;
+	unsigned int numOfExtraPages = newNumOfPages - oldNumOfPages;
+	if (nextPage < KHEAP_NUM_PAGES && kheapExtents[nextPage].size >= numOfExtraPages)
 	{
-		if (virtual_address >= (void *)AllocatedBlock[i].FirstVA &&
-			virtual_address < (void *)(AllocatedBlock[i].FirstVA + (AllocatedBlock[i].numOfAllocatedPages * PAGE_SIZE)))
+		kheap_take_pages(nextPage, nextPage, numOfExtraPages);
+		if (kheap_map_new_frames(nextPage, numOfExtraPages) == E_NO_MEM)
 		{
-			index = i;
-			break;
+			kheap_release_pages(nextPage, numOfExtraPages);
+			return NULL;
 		}
+		kheap_set_block_pages(nextPage, numOfExtraPages, startPage);
+		kheapPagesInfo[startPage].numOfAllocatedPages = newNumOfPages;
+		kheapPagesInfo[startPage].size = new_size;
+		return (void *)blockVA;
 	}
-	if (index == -1)
+
+	//[4] Move: place a new block, then remap the old frames to its beginning (no data copy)
+	//	  and allocate new frames for the rest only
+	int newStartPage = kheap_place_block(newNumOfPages);
+	if (newStartPage == KHEAP_NIL)
 	{
-		// The given virtual address is not in a valid allocated block
+		// The old block remains valid
 		return NULL;
 	}
-	//  If size is less than or equal to the size of the existing memory block, it returns the existing virtual address
-	if ((AllocatedBlock[index].numOfAllocatedPages * PAGE_SIZE) >= new_size)
+	if (kheap_map_new_frames(newStartPage + oldNumOfPages, numOfExtraPages) == E_NO_MEM)
 	{
-		return virtual_address;
+		kheap_release_pages(newStartPage, newNumOfPages);
+		return NULL;
 	}
-	else
+	uint32 newBlockVA = KERNEL_HEAP_START + newStartPage * PAGE_SIZE;
+	// map all the old frames at their new VAs by one call that maps the whole range or nothing, before unmapping
+	// any of them: the old block is still valid if a page table can't be created
+	struct Linked_List oldFrames;
+	LIST_INIT(&oldFrames);
+	for (int i = 0; i < oldNumOfPages; i++)
 	{
-		// kfree(virtual_address);
-		return kmalloc(new_size);
+		uint32 *ptr_table = NULL;
+		LIST_INSERT_TAIL(&oldFrames, get_frame_info(ptr_page_directory, (void *)(blockVA + i * PAGE_SIZE), &ptr_table));
 	}
+	if (map_frame_range(ptr_page_directory, &oldFrames, (void *)newBlockVA, oldNumOfPages, PERM_PRESENT | PERM_WRITEABLE) == E_NO_MEM)
+	{
+		// the old frames stay in no list [they're only mapped]; the new ones are freed by unmapping them
+		struct Frame_Info *ptr_fi;
+		LIST_FOREACH(ptr_fi, &oldFrames)
+		{
+			LIST_REMOVE(&oldFrames, ptr_fi);
+		}
+		for (int i = oldNumOfPages; i < newNumOfPages; i++)
+			unmap_frame(ptr_page_directory, (void *)(newBlockVA + i * PAGE_SIZE));
+		kheap_release_pages(newStartPage, newNumOfPages);
+		return NULL;
+	}
+	for (int i = 0; i < oldNumOfPages; i++)
+	{
+		uint32 *ptr_table = NULL;
+		struct Frame_Info *ptr_fi = get_frame_info(ptr_page_directory, (void *)(blockVA + i * PAGE_SIZE), &ptr_table);
+		unmap_frame(ptr_page_directory, (void *)(blockVA + i * PAGE_SIZE));
+		ptr_fi->kheap_va = newBlockVA + i * PAGE_SIZE;
+	}
+
+	kheap_set_block_pages(startPage, oldNumOfPages, KHEAP_NIL);
+	kheapPagesInfo[startPage].numOfAllocatedPages = 0;
+	kheapPagesInfo[startPage].size = 0;
+	kheap_release_pages(startPage, oldNumOfPages);
+
+	kheap_set_block_pages(newStartPage, newNumOfPages, newStartPage);
+	kheapPagesInfo[newStartPage].numOfAllocatedPages = newNumOfPages;
+	kheapPagesInfo[newStartPage].size = new_size;
+	return (void *)newBlockVA;
 }
@@ -12,6 +12,7 @@
 #define KHP_PLACE_NEXTFIT 0x3
 #define KHP_PLACE_WORSTFIT 0x4
 
+void initialize_kheap();
 void *kmalloc(unsigned int size);
 void kfree(void *virtual_address);
 void *krealloc(void *virtual_address, uint32 new_size);
@@ -19,6 +20,9 @@ void *krealloc(void *virtual_address, uint32 new_size);
 unsigned int kheap_virtual_address(unsigned int physical_address);
 unsigned int kheap_physical_address(unsigned int virtual_address);
 
+void kheap_print_statistics();
+void kheap_virtual_address_benchmark(uint32 numOfPages);
+
 int numOfKheapVACalls;
 
 #endif // FOS_KERN_KHEAP_H_
@@ -0,0 +1,130 @@
+#include <inc/stdio.h>
+#include <kern/load_control.h>
+#include <kern/memory_manager.h>
+#include <kern/file_manager.h>
+#include <kern/user_environment.h>
+#include <kern/sched.h>
+
+// Faults of the current window
+static uint32 windowNumOfTicks;
+static uint32 windowNumOfFaults;
+
+void load_control_enable(uint32 highFaults, uint32 lowFaults)
+{
+	loadControlHighFaults = MAX(highFaults, 1);
+	loadControlLowFaults = MIN(lowFaults, loadControlHighFaults - 1);
+	_LoadControlEnabled = 1;
+}
+void load_control_disable() { _LoadControlEnabled = 0; }
+uint8 isLoadControlEnabled() { return _LoadControlEnabled; }
+
+static uint8 is_memory_scarce()
+{
+	return calculate_free_frames() * 100 < memory_scarce_threshold_percentage * number_of_frames;
+}
+
+// Release the resident pages of e [it shouldn't be running]: the modified ones are written back to the page file
+// by one clustered batch first, so that they can be read again at their next faults [the clean pages only reserved
+// in the page file are zero-filled again]. Pages that aren't in the page file (e.g. shared ones) stay resident.
+// RETURNS: the number of pages released
+uint32 env_swap_out(struct Env *e)
+{
+	struct Linked_List modifiedFrames;
+	LIST_INIT(&modifiedFrames);
+	uint32 *ptr_page_table;
+	for (uint32 i = 0; i < e->page_WS_max_size; i++)
+	{
+		if (env_page_ws_is_entry_empty(e, i))
+			continue;
+		uint32 va = env_page_ws_get_virtual_address(e, i);
+		if (pf_count_env_pages(e, va, 1) == 0 && !pf_is_env_page_reserved(e, va))
+			continue;
+		if (pt_get_page_permissions(e, va) & PERM_MODIFIED)
+		{
+			struct Frame_Info *ptr_frame_info = get_frame_info(e->env_page_directory, (void *)va, &ptr_page_table);
+			ptr_frame_info->environment = e;
+			ptr_frame_info->va = va;
+			LIST_INSERT_TAIL(&modifiedFrames, ptr_frame_info);
+		}
+	}
+	pf_update_modified_frames(&modifiedFrames);
+	struct Frame_Info *ptr_frame_info;
+	LIST_FOREACH(ptr_frame_info, &modifiedFrames)
+	{
+		LIST_REMOVE(&modifiedFrames, ptr_frame_info);
+	}
+
+	uint32 numOfPages = 0;
+	for (uint32 i = 0; i < e->page_WS_max_size; i++)
+	{
+		if (env_page_ws_is_entry_empty(e, i))
+			continue;
+		uint32 va = env_page_ws_get_virtual_address(e, i);
+		if (pf_count_env_pages(e, va, 1) == 0 && !pf_is_env_page_reserved(e, va))
+			continue;
+		env_page_ws_clear_entry(e, i);
+		unmap_frame(e->env_page_directory, (void *)va);
+		numOfPages++;
+	}
+	e->page_last_WS_index = 0;
+	return numOfPages;
+}
+
+// Return the lowest-priority READY environment: the last one to run of the lowest non-empty ready queue
+// [envs are enqueued at the head and dequeued from the tail]
+static struct Env *get_lowest_priority_ready_env()
+{
+	for (int i = num_of_ready_queues - 1; i >= 0; i--)
+	{
+		if (!LIST_EMPTY(&(env_ready_queues[i])))
+			return LIST_FIRST(&(env_ready_queues[i]));
+	}
+	return NULL;
+}
+
+static void load_control_swap_out_one()
+{
+	struct Env *e = get_lowest_priority_ready_env();
+	if (e == NULL)
+		return;
+	sched_remove_ready(e);
+	uint32 numOfPages = env_swap_out(e);
+	sched_insert_suspended(e);
+
+	e->nSwapOuts++;
+	loadControlNumOfSwapOuts++;
+	loadControlNumOfSwappedPages += numOfPages;
+}
+
+// Called at each clock tick [the running env, if any, is curenv]
+void load_control_on_clock()
+{
+	if (!isLoadControlEnabled())
+		return;
+
+	if (curenv != NULL)
+	{
+		windowNumOfFaults += curenv->pageFaultsCounter - curenv->lcLastPageFaultsCounter;
+		curenv->lcLastPageFaultsCounter = curenv->pageFaultsCounter;
+	}
+	if (++windowNumOfTicks < LOAD_CONTROL_WINDOW)
+		return;
+
+	if (windowNumOfFaults >= loadControlHighFaults && is_memory_scarce())
+		load_control_swap_out_one();
+	else if (windowNumOfFaults <= loadControlLowFaults && !is_memory_scarce())
+		sched_readmit_suspended();
+
+	windowNumOfTicks = windowNumOfFaults = 0;
+}
+
+void load_control_print_statistics()
+{
+	if (isLoadControlEnabled())
+		cprintf("Load control: swap out above %d faults, re-admit below %d faults per %d ticks when memory is scarce (free frames < %d%%)\n",
+				loadControlHighFaults, loadControlLowFaults, LOAD_CONTROL_WINDOW, memory_scarce_threshold_percentage);
+	else
+		cprintf("Load control is disabled\n");
+	cprintf("Swap outs = %d (pages released = %d), re-admissions = %d, free frames = %d/%d\n",
+			loadControlNumOfSwapOuts, loadControlNumOfSwappedPages, loadControlNumOfReadmissions, calculate_free_frames(), number_of_frames);
+}
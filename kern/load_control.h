@@ -0,0 +1,40 @@
+#ifndef FOS_KERN_LOAD_CONTROL_H_
+#define FOS_KERN_LOAD_CONTROL_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/environment_definitions.h>
+
+// Load control [medium-term scheduler]: the page faults of the running environments are summed over windows
+// of LOAD_CONTROL_WINDOW clock ticks. At the end of a window:
+//	- if the faults reach the high threshold while memory is scarce (the free frames are below
+//	  memory_scarce_threshold_percentage), the system is thrashing: the lowest-priority READY environment
+//	  is swapped out [its modified resident pages are written to the page file in one clustered batch,
+//	  its resident frames are released] and put in the SUSPENDED queue
+//	- if the faults are down to the low threshold and memory isn't scarce, the environment that was
+//	  suspended first is re-admitted to the READY queue
+// A suspended environment is also re-admitted when there's nothing else to run.
+
+#define LOAD_CONTROL_WINDOW 10 // clock ticks
+#define LOAD_CONTROL_DEFAULT_LOW_FAULTS 10
+
+uint8 _LoadControlEnabled;
+uint32 loadControlHighFaults; // page faults per window
+uint32 loadControlLowFaults;
+
+uint32 loadControlNumOfSwapOuts;
+uint32 loadControlNumOfSwappedPages;
+uint32 loadControlNumOfReadmissions; // see sched_readmit_suspended()
+
+void load_control_enable(uint32 highFaults, uint32 lowFaults);
+void load_control_disable();
+uint8 isLoadControlEnabled();
+
+uint32 env_swap_out(struct Env *e);
+void load_control_on_clock();
+void load_control_print_statistics();
+
+#endif // FOS_KERN_LOAD_CONTROL_H_
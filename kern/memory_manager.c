@@ -23,6 +23,8 @@ FUNCTIONS:	to_physical_address, get_frame_info, tlb_invalidate
 #include <kern/user_environment.h>
 #include <kern/sched.h>
 #include <kern/kheap.h>
+#include <kern/buddy.h>
+#include <kern/page_replacement.h>
 #include <kern/file_manager.h>
 
 extern uint32 number_of_frames;	// Amount of physical memory (in frames_info)
@@ -52,8 +54,10 @@ char* ptr_free_mem;	// Pointer to next byte of free mem
 
 struct Frame_Info* frames_info;		// Virtual address of physical frames_info array
 struct Frame_Info* disk_frames_info;		// Virtual address of physical frames_info array
-struct Linked_List free_frame_list;	// Free list of physical frames_info
+struct Linked_List free_frame_list;	// Free list of the BUFFERED physical frames_info (the not-buffered free frames are kept by the buddy allocator)
 struct Linked_List modified_frame_list;
+uint32 numOfFreeBufferedFrames;		// Number of buffered frames in free_frame_list (maintained incrementally)
+struct Linked_List zeroed_frames_pool;	// Free frames that are already zeroed (counted as free frames)
 
 
 ///**************************** MAPPING KERNEL SPACE *******************************
@@ -343,6 +347,10 @@ void initialize_paging()
 	int i;
 	LIST_INIT(&free_frame_list);
 	LIST_INIT(&modified_frame_list);
+	buddy_initialize();
+	numOfFreeBufferedFrames = 0;
+	LIST_INIT(&zeroed_frames_pool);
+	zeroed_frames_pool_watermark = DEFAULT_ZEROED_FRAMES_POOL_WATERMARK;
 
 	frames_info[0].references = 1;
 	frames_info[1].references = 1;
@@ -364,7 +372,7 @@ void initialize_paging()
 		initialize_frame_info(&(frames_info[i]));
 		//frames_info[i].references = 0;
 
-		LIST_INSERT_HEAD(&free_frame_list, &frames_info[i]);
+		buddy_free_block(&frames_info[i], 0);
 	}
 
 	for (i = PHYS_IO_MEM/PAGE_SIZE ; i < PHYS_EXTENDED_MEM/PAGE_SIZE; i++)
@@ -384,7 +392,7 @@ void initialize_paging()
 		initialize_frame_info(&(frames_info[i]));
 
 		//frames_info[i].references = 0;
-		LIST_INSERT_HEAD(&free_frame_list, &frames_info[i]);
+		buddy_free_block(&frames_info[i], 0);
 	}
 
 	initialize_disk_page_file();
@@ -419,11 +427,25 @@ extern void env_free(struct Env *e);
 
 int allocate_frame(struct Frame_Info **ptr_frame_info)
 {
+	// Not-buffered free frames first
+	*ptr_frame_info = buddy_allocate_block(0);
+	if (*ptr_frame_info != NULL)
+	{
+		initialize_frame_info(*ptr_frame_info);
+		return 0;
+	}
+
+	// Then reclaim a buffered frame
 	*ptr_frame_info = LIST_FIRST(&free_frame_list);
 	int c = 0;
 	if (*ptr_frame_info == NULL)
 	{
-		panic("ERROR: Kernel run out of memory... allocate_frame cannot find a free frame.\n");
+		// the pre-zeroed frames are free frames as well
+		*ptr_frame_info = LIST_FIRST(&zeroed_frames_pool);
+		if (*ptr_frame_info == NULL)
+			panic("ERROR: Kernel run out of memory... allocate_frame cannot find a free frame.\n");
+		LIST_REMOVE(&zeroed_frames_pool, *ptr_frame_info);
+		return 0;
 	}
 
 	LIST_REMOVE(&free_frame_list,*ptr_frame_info);
@@ -433,6 +455,7 @@ int allocate_frame(struct Frame_Info **ptr_frame_info)
 
 	if((*ptr_frame_info)->isBuffered)
 	{
+		numOfFreeBufferedFrames--;
 		pt_clear_page_table_entry((*ptr_frame_info)->environment,(*ptr_frame_info)->va);
 		//pt_set_page_permissions((*ptr_frame_info)->environment->env_pgdir, (*ptr_frame_info)->va, 0, PERM_BUFFERED);
 	}
@@ -445,6 +468,78 @@ int allocate_frame(struct Frame_Info **ptr_frame_info)
 	return 0;
 }
 
+// Zero the given frame through the kernel zeroing window
+static void zero_frame(struct Frame_Info *ptr_frame_info)
+{
+	uint32 *ptr_page_table;
+	get_page_table(ptr_page_directory, (void *)KERNEL_ZEROING_WINDOW, &ptr_page_table);
+	ptr_page_table[PTX(KERNEL_ZEROING_WINDOW)] = CONSTRUCT_ENTRY(to_physical_address(ptr_frame_info), PERM_PRESENT | PERM_WRITEABLE);
+	tlb_invalidate(ptr_page_directory, (void *)KERNEL_ZEROING_WINDOW);
+
+	memset((void *)KERNEL_ZEROING_WINDOW, 0, PAGE_SIZE);
+
+	ptr_page_table[PTX(KERNEL_ZEROING_WINDOW)] = 0;
+	tlb_invalidate(ptr_page_directory, (void *)KERNEL_ZEROING_WINDOW);
+}
+
+//
+// Allocates a physical frame whose content is all zeros.
+// It's taken from the pool of pre-zeroed frames if possible (hit),
+// otherwise a free frame is allocated and zeroed on the spot (miss).
+//
+// RETURNS
+//   0 -- on success
+//   If failed, it panic (as allocate_frame()).
+//
+int allocate_zeroed_frame(struct Frame_Info **ptr_frame_info)
+{
+	*ptr_frame_info = LIST_FIRST(&zeroed_frames_pool);
+	if (*ptr_frame_info != NULL)
+	{
+		LIST_REMOVE(&zeroed_frames_pool, *ptr_frame_info);
+		zeroedFramesPoolHits++;
+		return 0;
+	}
+	zeroedFramesPoolMisses++;
+	allocate_frame(ptr_frame_info);
+	zero_frame(*ptr_frame_info);
+	return 0;
+}
+
+//
+// Zero free frames into the pool till it reaches its watermark.
+// Only not-buffered free frames (from the buddy allocator) are taken, so no buffered page loses its chance to be reclaimed.
+// Should be called when the kernel is idle (i.e. no environment is running).
+//
+void refill_zeroed_frames_pool()
+{
+	while (LIST_SIZE(&zeroed_frames_pool) < zeroed_frames_pool_watermark)
+	{
+		struct Frame_Info *ptr_frame_info = buddy_allocate_block(0);
+		if (ptr_frame_info == NULL)
+			break;
+		initialize_frame_info(ptr_frame_info);
+		zero_frame(ptr_frame_info);
+		LIST_INSERT_HEAD(&zeroed_frames_pool, ptr_frame_info);
+	}
+	// give back the extra frames if the watermark is lowered
+	while (LIST_SIZE(&zeroed_frames_pool) > zeroed_frames_pool_watermark)
+	{
+		struct Frame_Info *ptr_frame_info = LIST_FIRST(&zeroed_frames_pool);
+		LIST_REMOVE(&zeroed_frames_pool, ptr_frame_info);
+		buddy_free_block(ptr_frame_info, 0);
+	}
+}
+
+void print_zeroed_frames_pool_statistics()
+{
+	uint32 numOfRequests = zeroedFramesPoolHits + zeroedFramesPoolMisses;
+	cprintf("Zeroed frames pool: %d/%d frames, hits = %d, misses = %d", LIST_SIZE(&zeroed_frames_pool), zeroed_frames_pool_watermark, zeroedFramesPoolHits, zeroedFramesPoolMisses);
+	if (numOfRequests > 0)
+		cprintf(" (hit ratio = %d%%)", (zeroedFramesPoolHits * 100) / numOfRequests);
+	cprintf("\n");
+}
+
 //
 // Return a frame to the free_frame_list.
 // (This function should only be called when ptr_frame_info->references reaches 0.)
@@ -456,12 +551,43 @@ void free_frame(struct Frame_Info *ptr_frame_info)
 	/*=============================================================================*/
 
 	// Fill this function in
-	LIST_INSERT_HEAD(&free_frame_list, ptr_frame_info);
+	buddy_free_block(ptr_frame_info, 0);
 	//LOG_STATMENT(cprintf("FN # %d FREED",to_frame_number(ptr_frame_info)));
 
 
 }
 
+//
+// Allocates 2^order physically contiguous frames (e.g. for DMA buffers or large mappings).
+// Only not-buffered free frames are used. The frames are initialized as in allocate_frame().
+//
+// *ptr_first_frame_info -- is set to point to the Frame_Info struct of the first frame of the block
+//
+// RETURNS
+//   0 -- on success
+//   E_NO_MEM -- if there is no free block of this order
+//
+int allocate_contiguous_frames(uint32 order, struct Frame_Info **ptr_first_frame_info)
+{
+	*ptr_first_frame_info = buddy_allocate_block(order);
+	if (*ptr_first_frame_info == NULL)
+		return E_NO_MEM;
+	for (int i = 0; i < (1 << order); i++)
+		initialize_frame_info(*ptr_first_frame_info + i);
+	return 0;
+}
+
+//
+// Return a block allocated by allocate_contiguous_frames() at once
+// (its frames can also be freed one by one with free_frame())
+//
+void free_contiguous_frames(struct Frame_Info *ptr_first_frame_info, uint32 order)
+{
+	for (int i = 0; i < (1 << order); i++)
+		initialize_frame_info(ptr_first_frame_info + i);
+	buddy_free_block(ptr_first_frame_info, order);
+}
+
 //
 // Decrement the reference count on a frame
 // freeing it if there are no more references.
@@ -533,13 +659,13 @@ int get_page_table(uint32 *ptr_page_directory, const void *virtual_address, uint
 	}
 }
 
-void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_address)
+// Same as create_page_table() but returns NULL instead of panicking if there's no kernel heap space
+static uint32 * try_create_page_table(uint32 *ptr_page_directory, const uint32 virtual_address)
 {
-	//CREATE_PAGE_TABLE IS IMPLEMENTED FOR 23'PRO
 	uint32 * ptr_page_table = kmalloc(PAGE_SIZE);
 	if(ptr_page_table == NULL)
 	{
-		panic("NOT ENOUGH KERNEL HEAP SPACE");
+		return NULL;
 	}
 	ptr_page_directory[PDX(virtual_address)] = CONSTRUCT_ENTRY(
 			kheap_physical_address((unsigned int)ptr_page_table)
@@ -553,6 +679,17 @@ void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_addres
 	return ptr_page_table;
 }
 
+void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_address)
+{
+	//CREATE_PAGE_TABLE IS IMPLEMENTED FOR 23'PRO
+	uint32 * ptr_page_table = try_create_page_table(ptr_page_directory, virtual_address);
+	if(ptr_page_table == NULL)
+	{
+		panic("NOT ENOUGH KERNEL HEAP SPACE");
+	}
+	return ptr_page_table;
+}
+
 
 
 void __static_cpt(uint32 *ptr_page_directory, const uint32 virtual_address, uint32 **ptr_page_table)
@@ -699,6 +836,102 @@ void unmap_frame(uint32 *ptr_page_directory, void *virtual_address)
 	}
 }
 
+//
+// Allocates 'numOfFrames' physical frames and appends them to 'ptr_frames_list'
+// (linked through their prev_next_info, in allocation order).
+// Either all the frames are allocated or none of them.
+//
+// RETURNS:
+//   0 on success
+//   E_NO_MEM if there are not enough free frames
+//
+int allocate_frames(uint32 numOfFrames, struct Linked_List *ptr_frames_list)
+{
+	if (calculate_free_frames() < numOfFrames)
+		return E_NO_MEM;
+
+	for (int i = 0; i < numOfFrames; i++)
+	{
+		struct Frame_Info *ptr_frame_info;
+		allocate_frame(&ptr_frame_info);
+		LIST_INSERT_TAIL(ptr_frames_list, ptr_frame_info);
+	}
+	return 0;
+}
+
+//
+// Return all the frames of 'ptr_frames_list' to the free_frame_list
+// (used to roll back allocate_frames())
+//
+void free_frames(struct Linked_List *ptr_frames_list)
+{
+	struct Frame_Info *ptr_frame_info;
+	while ((ptr_frame_info = LIST_FIRST(ptr_frames_list)) != NULL)
+	{
+		LIST_REMOVE(ptr_frames_list, ptr_frame_info);
+		free_frame(ptr_frame_info);
+	}
+}
+
+//
+// Map the first 'numOfPages' frames of 'ptr_frames_list' at the consecutive pages starting from 'virtual_address'
+// (removing them from the list). Same as calling map_frame() on each page, except that each
+// page table is looked up once per 4 MB and its consecutive entries are filled directly.
+//
+// All the missing page tables are created before touching any entry, so the call either maps
+// the whole range or nothing (the frames remain in the list in this case).
+//
+// RETURNS:
+//   0 on success
+//   E_NO_MEM if a missing page table can't be created
+//
+int map_frame_range(uint32 *ptr_page_directory, struct Linked_List *ptr_frames_list, void *virtual_address, uint32 numOfPages, int perm)
+{
+	uint32 start_va = ROUNDDOWN((uint32)virtual_address, PAGE_SIZE);
+	uint32 end_va = start_va + numOfPages * PAGE_SIZE;
+	uint32 *ptr_page_table;
+	if (numOfPages == 0)
+		return 0;
+	if (LIST_SIZE(ptr_frames_list) < numOfPages)
+		return E_NO_MEM;
+
+	//[1] Make sure that all the page tables of the range exist
+	for (uint32 table_number = PDX(start_va); table_number <= PDX(end_va - 1); table_number++)
+	{
+		uint32 va = table_number * PTSIZE;
+		if (get_page_table(ptr_page_directory, (void *)va, &ptr_page_table) == TABLE_NOT_EXIST)
+		{
+			if (USE_KHEAP)
+			{
+				if (try_create_page_table(ptr_page_directory, va) == NULL)
+					return E_NO_MEM;
+			}
+			else
+			{
+				__static_cpt(ptr_page_directory, va, &ptr_page_table);
+			}
+		}
+	}
+
+	//[2] Fill the entries, one page table lookup per 4 MB
+	ptr_page_table = NULL;
+	for (uint32 va = start_va; va < end_va; va += PAGE_SIZE)
+	{
+		if (ptr_page_table == NULL || PTX(va) == 0)
+			get_page_table(ptr_page_directory, (void *)va, &ptr_page_table);
+
+		struct Frame_Info *ptr_frame_info = LIST_FIRST(ptr_frames_list);
+		LIST_REMOVE(ptr_frames_list, ptr_frame_info);
+		uint32 physical_address = to_physical_address(ptr_frame_info);
+
+		// a frame that is already mapped here is replaced (the new frames are not mapped anywhere yet)
+		if ((ptr_page_table[PTX(va)] & PERM_PRESENT) == PERM_PRESENT)
+			unmap_frame(ptr_page_directory, (void *)va);
+		ptr_frame_info->references++;
+		ptr_page_table[PTX(va)] = CONSTRUCT_ENTRY(physical_address, perm | PERM_PRESENT);
+	}
+	return 0;
+}
 
 /*/this function should be called only in the env_create() for creating the page table if not exist
  * (without causing page fault as the normal map_frame())*/
@@ -780,13 +1013,12 @@ void allocateMem(struct Env *e, uint32 virtual_address, uint32 size)
 		NumOfNeededPages = (size / PAGE_SIZE) + 1;
 	}
 
-	for (int i = 0; i < NumOfNeededPages; i++)
+	// the range is given one run of consecutive disk frames when possible, or only reserved in the page file when
+	// the allocation is lazy [see pf_add_empty_env_pages()]
+	int ret = pf_add_empty_env_pages(e, virtual_address, NumOfNeededPages);
+	if (ret == E_NO_PAGE_FILE_SPACE)
 	{
-		int ret = pf_add_empty_env_page(e, (virtual_address + (PAGE_SIZE * i)), 0);
-		if (ret == E_NO_PAGE_FILE_SPACE)
-		{
-			panic("ERROR: No enough virtual space on the page file!");
-		}
+		panic("ERROR: No enough virtual space on the page file!");
 	}
 
 	// This function should allocate ALL pages of the required range in the PAGE FILE
@@ -823,9 +1055,20 @@ void __freeMem_with_buffering(struct Env *e, uint32 virtual_address, uint32 size
 	}
 
 	// 2. Free ONLY pages that are resident in the working set from the memory
-	for (int i = 0; i < e->page_WS_max_size; i++)
+	//    (look the pages of the range up in the WS hash, unless the range is larger than the WS)
+	for (int i = 0; i < MIN(NumOfNeededPages, e->page_WS_max_size); i++)
 	{
-		uint32 Address = env_page_ws_get_virtual_address(e, i);
+		int32 entry_index = i;
+		if (NumOfNeededPages < e->page_WS_max_size)
+		{
+			entry_index = env_page_ws_lookup(e, virtual_address + (PAGE_SIZE * i));
+			if (entry_index < 0)
+				continue;
+		}
+		else if (env_page_ws_is_entry_empty(e, entry_index))
+			continue;
+
+		uint32 Address = env_page_ws_get_virtual_address(e, entry_index);
 		uint32 *ptr_table = NULL;
 		struct Frame_Info *ptr_frame_info = get_frame_info(e->env_page_directory, (void *)Address, &ptr_table);
 		if (Address >= virtual_address && Address < (virtual_address + size))
@@ -834,7 +1077,7 @@ void __freeMem_with_buffering(struct Env *e, uint32 virtual_address, uint32 size
 			{
 				unmap_frame(e->env_page_directory,(void*)Address);
 				pt_clear_page_table_entry(e, Address);
-				env_page_ws_clear_entry(e, i); // update the WS
+				env_page_ws_clear_entry(e, entry_index); // update the WS
 			}
 		}
 	}
@@ -855,9 +1098,9 @@ void __freeMem_with_buffering(struct Env *e, uint32 virtual_address, uint32 size
 			}
 			else
 			{
+				bufferlist_remove_page(&free_frame_list, ptr_frame_info);
 				ptr_frame_info->isBuffered = 0;
 				ptr_frame_info->environment = NULL;
-				bufferlist_remove_page(&free_frame_list, ptr_frame_info);
 				free_frame(ptr_frame_info);
 			}
 			pt_clear_page_table_entry(e, (virtual_address + (PAGE_SIZE * i))); // Clear the page directory entry for the given virtual address
@@ -953,7 +1196,8 @@ uint32 calculate_required_frames(uint32* ptr_page_directory, uint32 start_virtua
 
 
 // calculate_available_frames:
-struct freeFramesCounters calculate_available_frames()
+// Count the frames by walking the free and modified lists (used to cross-check the counters)
+static struct freeFramesCounters calculate_available_frames_by_walk()
 {
 	//DETECTING LOOP inside the list
 	//================================
@@ -1005,6 +1249,18 @@ struct freeFramesCounters calculate_available_frames()
 		totalModified++ ;
 	}
 
+	LIST_FOREACH(ptr, &zeroed_frames_pool)
+	{
+		totalFreeUnBuffered++ ;
+	}
+
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++)
+	{
+		LIST_FOREACH(ptr, &buddy_free_lists[order])
+		{
+			totalFreeUnBuffered += (1 << order) ;
+		}
+	}
 
 	struct freeFramesCounters counters ;
 	counters.freeBuffered = totalFreeBuffered ;
@@ -1013,11 +1269,30 @@ struct freeFramesCounters calculate_available_frames()
 	return counters;
 }
 
+// free_frame_list and modified_frame_list maintain their sizes, and the buffered frames of
+// free_frame_list are counted on insertion/removal, so no list walk is needed here
+struct freeFramesCounters calculate_available_frames()
+{
+	struct freeFramesCounters counters ;
+	counters.freeBuffered = numOfFreeBufferedFrames ;
+	counters.freeNotBuffered = buddy_num_of_free_frames() + LIST_SIZE(&free_frame_list) - numOfFreeBufferedFrames + LIST_SIZE(&zeroed_frames_pool) ;
+	counters.modified = LIST_SIZE(&modified_frame_list);
+
+	if (CHECK_FRAME_COUNTERS)
+	{
+		struct freeFramesCounters walked = calculate_available_frames_by_walk();
+		if (walked.freeBuffered != counters.freeBuffered || walked.freeNotBuffered != counters.freeNotBuffered || walked.modified != counters.modified)
+			panic("calculate_available_frames: counters (buffered = %d, not buffered = %d, modified = %d) don't match the lists (buffered = %d, not buffered = %d, modified = %d)",
+					counters.freeBuffered, counters.freeNotBuffered, counters.modified, walked.freeBuffered, walked.freeNotBuffered, walked.modified);
+	}
+	return counters;
+}
+
 //2018
 // calculate_free_frames:
 uint32 calculate_free_frames()
 {
-	return LIST_SIZE(&free_frame_list);
+	return buddy_num_of_free_frames() + LIST_SIZE(&free_frame_list) + LIST_SIZE(&zeroed_frames_pool);
 }
 
 
@@ -1025,32 +1300,202 @@ uint32 calculate_free_frames()
 ///============================================================================================
 /// Dealing with environment working set
 
+// The working set keeps an index next to its array so that the page fault handler doesn't scan it:
+// a count of the non-empty entries, a two-level bitmap of the empty entries (to find the lowest empty
+// entry by checking one summary word per 1024 entries), a chained hash of the entries by VA and
+// a queue of the non-empty entries in the order they were loaded (for FIFO replacement).
+
+#define WS_INDEX_NIL -1
+
+static inline uint32 ws_num_of_bitmap_words(uint32 numOfElements)
+{
+	return (numOfElements + 31) / 32;
+}
+
+static inline uint32 ws_num_of_summary_words(uint32 numOfElements)
+{
+	return (ws_num_of_bitmap_words(numOfElements) + 31) / 32;
+}
+
+static inline uint32 ws_num_of_hash_buckets(uint32 numOfElements)
+{
+	uint32 numOfBuckets = 8;
+	while (numOfBuckets < numOfElements)
+		numOfBuckets <<= 1;
+	return numOfBuckets;
+}
+
+static inline uint32 ws_hash(struct Env *e, uint32 virtual_address)
+{
+	uint32 vpn = virtual_address >> PGSHIFT;
+	return (vpn ^ (vpn >> 10)) & e->__pws_hash_mask;
+}
+
+static inline void ws_mark_empty(struct Env *e, uint32 entry_index)
+{
+	uint32 word = entry_index / 32;
+	e->__pws_free_bitmap[word] |= (1U << (entry_index % 32));
+	e->__pws_free_summary[word / 32] |= (1U << (word % 32));
+}
+
+static inline void ws_mark_used(struct Env *e, uint32 entry_index)
+{
+	uint32 word = entry_index / 32;
+	e->__pws_free_bitmap[word] &= ~(1U << (entry_index % 32));
+	if (e->__pws_free_bitmap[word] == 0)
+		e->__pws_free_summary[word / 32] &= ~(1U << (word % 32));
+}
+
+static void ws_hash_insert(struct Env *e, uint32 entry_index)
+{
+	uint32 bucket = ws_hash(e, e->ptr_pageWorkingSet[entry_index].virtual_address);
+	e->__pws_hash_next[entry_index] = e->__pws_hash_buckets[bucket];
+	e->__pws_hash_buckets[bucket] = entry_index;
+}
+
+static void ws_fifo_append(struct Env *e, uint32 entry_index)
+{
+	e->__pws_fifo_next[entry_index] = WS_INDEX_NIL;
+	e->__pws_fifo_prev[entry_index] = e->__pws_fifo_tail;
+	if (e->__pws_fifo_tail != WS_INDEX_NIL)
+		e->__pws_fifo_next[e->__pws_fifo_tail] = entry_index;
+	else
+		e->__pws_fifo_head = entry_index;
+	e->__pws_fifo_tail = entry_index;
+}
+
+static void ws_fifo_remove(struct Env *e, uint32 entry_index)
+{
+	int32 prev = e->__pws_fifo_prev[entry_index];
+	int32 next = e->__pws_fifo_next[entry_index];
+	if (prev != WS_INDEX_NIL)
+		e->__pws_fifo_next[prev] = next;
+	else
+		e->__pws_fifo_head = next;
+	if (next != WS_INDEX_NIL)
+		e->__pws_fifo_prev[next] = prev;
+	else
+		e->__pws_fifo_tail = prev;
+}
+
+static void ws_hash_remove(struct Env *e, uint32 entry_index)
+{
+	int32 *link = &e->__pws_hash_buckets[ws_hash(e, e->ptr_pageWorkingSet[entry_index].virtual_address)];
+	while (*link != WS_INDEX_NIL && *link != entry_index)
+		link = &e->__pws_hash_next[*link];
+	if (*link == WS_INDEX_NIL)
+		panic("env_page_ws: entry %d of env %d is missing from the WS hash", entry_index, e->env_id);
+	*link = e->__pws_hash_next[entry_index];
+}
+
+// Size in bytes of the index of a working set with numOfElements elements
+uint32 env_page_ws_index_size(uint32 numOfElements)
+{
+	return sizeof(uint32) * (ws_num_of_bitmap_words(numOfElements) + ws_num_of_summary_words(numOfElements) + ws_num_of_hash_buckets(numOfElements) + 3 * numOfElements);
+}
+
+// Attach the given index memory [of env_page_ws_index_size() bytes] to the working set of e and empty all its entries
+void env_page_ws_initialize(struct Env *e, void *index)
+{
+	uint32 numOfElements = e->page_WS_max_size;
+	uint32 numOfBuckets = ws_num_of_hash_buckets(numOfElements);
+
+	e->__pws_free_bitmap = (uint32 *)index;
+	e->__pws_free_summary = e->__pws_free_bitmap + ws_num_of_bitmap_words(numOfElements);
+	e->__pws_hash_buckets = (int32 *)(e->__pws_free_summary + ws_num_of_summary_words(numOfElements));
+	e->__pws_hash_next = e->__pws_hash_buckets + numOfBuckets;
+	e->__pws_hash_mask = numOfBuckets - 1;
+	e->__pws_fifo_next = e->__pws_hash_next + numOfElements;
+	e->__pws_fifo_prev = e->__pws_fifo_next + numOfElements;
+	e->__pws_fifo_head = e->__pws_fifo_tail = WS_INDEX_NIL;
+	e->__pws_arc = NULL;
+
+	memset(index, 0, sizeof(uint32) * (ws_num_of_bitmap_words(numOfElements) + ws_num_of_summary_words(numOfElements)));
+	for (int i = 0; i < numOfBuckets; i++)
+		e->__pws_hash_buckets[i] = WS_INDEX_NIL;
+
+	for (int i = 0; i < numOfElements; i++)
+	{
+		e->ptr_pageWorkingSet[i].virtual_address = 0;
+		e->ptr_pageWorkingSet[i].empty = 1;
+		e->ptr_pageWorkingSet[i].time_stamp = 0;
+		e->__pws_hash_next[i] = e->__pws_fifo_next[i] = e->__pws_fifo_prev[i] = WS_INDEX_NIL;
+		ws_mark_empty(e, i);
+	}
+	e->page_WS_size = 0;
+}
+
  uint32 env_page_ws_get_size(struct Env *e)
 {
-	int i=0, counter=0;
-	for(;i<e->page_WS_max_size; i++) if(e->ptr_pageWorkingSet[i].empty == 0) counter++;
-	return counter;
+	return e->page_WS_size;
 }
 
- void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
+// Return the number of pages the WS can hold: its max size less the spare entries of its array, which are left
+// empty [entries given to other envs, or allocated ahead, by global replacement: see env_page_ws_grow_quota()]
+ uint32 env_page_ws_get_quota(struct Env *e)
 {
-	int i=0;
-	for(;i<e->page_WS_max_size; i++)
+	return e->page_WS_max_size - e->page_WS_num_of_spare_entries;
+}
+
+// Return the index of the lowest empty entry of the WS, or -1 if it's full
+int32 env_page_ws_find_empty_entry(struct Env *e)
+{
+	uint32 numOfSummaryWords = ws_num_of_summary_words(e->page_WS_max_size);
+	for (int i = 0; i < numOfSummaryWords; i++)
 	{
-		if(ROUNDDOWN(e->ptr_pageWorkingSet[i].virtual_address,PAGE_SIZE) == ROUNDDOWN(virtual_address,PAGE_SIZE))
+		if (e->__pws_free_summary[i] != 0)
 		{
-			env_page_ws_clear_entry(e, i);
-			break;
+			uint32 word = i * 32 + __builtin_ctz(e->__pws_free_summary[i]);
+			return word * 32 + __builtin_ctz(e->__pws_free_bitmap[word]);
 		}
 	}
+	return WS_INDEX_NIL;
+}
+
+// Return the index of the WS entry that was loaded first, or -1 if the WS is empty
+int32 env_page_ws_get_oldest_entry(struct Env *e)
+{
+	return e->__pws_fifo_head;
+}
+
+// Return the index of the WS entry of the given page, or -1 if it's not in the WS
+int32 env_page_ws_lookup(struct Env *e, uint32 virtual_address)
+{
+	virtual_address = ROUNDDOWN(virtual_address, PAGE_SIZE);
+	int32 entry_index = e->__pws_hash_buckets[ws_hash(e, virtual_address)];
+	while (entry_index != WS_INDEX_NIL && e->ptr_pageWorkingSet[entry_index].virtual_address != virtual_address)
+		entry_index = e->__pws_hash_next[entry_index];
+	return entry_index;
+}
+
+ void env_page_ws_invalidate(struct Env* e, uint32 virtual_address)
+{
+	int32 entry_index = env_page_ws_lookup(e, virtual_address);
+	if (entry_index != WS_INDEX_NIL)
+		env_page_ws_clear_entry(e, entry_index);
 }
 
  void env_page_ws_set_entry(struct Env* e, uint32 entry_index, uint32 virtual_address)
 {
 	assert(entry_index >= 0 && entry_index < e->page_WS_max_size);
 	assert(virtual_address >= 0 && virtual_address < USER_TOP);
+	if (e->ptr_pageWorkingSet[entry_index].empty)
+	{
+		ws_mark_used(e, entry_index);
+		e->page_WS_size++;
+	}
+	else
+	{
+		ws_hash_remove(e, entry_index);
+		ws_fifo_remove(e, entry_index);
+		page_replacement_ws_entry_cleared(e, entry_index);
+	}
+
 	e->ptr_pageWorkingSet[entry_index].virtual_address = ROUNDDOWN(virtual_address,PAGE_SIZE);
 	e->ptr_pageWorkingSet[entry_index].empty = 0;
+	ws_hash_insert(e, entry_index);
+	ws_fifo_append(e, entry_index);
+	page_replacement_ws_entry_set(e, entry_index);
 
 	e->ptr_pageWorkingSet[entry_index].time_stamp = 0x80000000;
 	//e->ptr_pageWorkingSet[entry_index].time_stamp = time;
@@ -1060,6 +1505,14 @@ uint32 calculate_free_frames()
  void env_page_ws_clear_entry(struct Env* e, uint32 entry_index)
 {
 	assert(entry_index >= 0 && entry_index < (e->page_WS_max_size));
+	if (!e->ptr_pageWorkingSet[entry_index].empty)
+	{
+		ws_hash_remove(e, entry_index);
+		ws_fifo_remove(e, entry_index);
+		page_replacement_ws_entry_cleared(e, entry_index);
+		ws_mark_empty(e, entry_index);
+		e->page_WS_size--;
+	}
 	e->ptr_pageWorkingSet[entry_index].virtual_address = 0;
 	e->ptr_pageWorkingSet[entry_index].empty = 1;
 	e->ptr_pageWorkingSet[entry_index].time_stamp = 0;
@@ -1278,10 +1731,14 @@ void bufferList_add_page(struct Linked_List* bufferList,struct Frame_Info *ptr_f
 	}
 	 */
 	LIST_INSERT_TAIL(bufferList, ptr_frame_info);
+	if (bufferList == &free_frame_list && ptr_frame_info->isBuffered)
+		numOfFreeBufferedFrames++;
 }
 void bufferlist_remove_page(struct Linked_List* bufferList, struct Frame_Info *ptr_frame_info)
 {
 	LIST_REMOVE(bufferList, ptr_frame_info);
+	if (bufferList == &free_frame_list && ptr_frame_info->isBuffered)
+		numOfFreeBufferedFrames--;
 }
 
 
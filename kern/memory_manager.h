@@ -60,6 +60,23 @@ uint32 memory_scarce_threshold_percentage;	// Memory remains plentiful till the
 
 //Functions
 uint32 calculate_free_frames();
+
+//***********************************
+//Pool of pre-zeroed frames (refilled while the kernel is idle)
+uint32 zeroed_frames_pool_watermark;	// Max number of frames kept zeroed in the pool
+#define DEFAULT_ZEROED_FRAMES_POOL_WATERMARK 32
+uint32 zeroedFramesPoolHits;
+uint32 zeroedFramesPoolMisses;
+
+int allocate_zeroed_frame(struct Frame_Info **ptr_frame_info);
+void refill_zeroed_frames_pool();
+void print_zeroed_frames_pool_statistics();
+
+// Set to 1 to cross-check the incremental frame counters against a full walk of the lists on every calculate_available_frames()
+// [e.g. make KERN_DEFS=-DCHECK_FRAME_COUNTERS=1]
+#ifndef CHECK_FRAME_COUNTERS
+#define CHECK_FRAME_COUNTERS 0
+#endif
 //***********************************
 
 struct freeFramesCounters
@@ -93,6 +110,8 @@ void	initialize_kernel_VM();
 void	initialize_paging();
 int allocate_frame(struct Frame_Info **ptr_frame_info);
 void free_frame(struct Frame_Info *ptr_frame_info);
+int allocate_contiguous_frames(uint32 order, struct Frame_Info **ptr_first_frame_info);
+void free_contiguous_frames(struct Frame_Info *ptr_first_frame_info, uint32 order);
 int get_page_table(uint32 *ptr_page_directory, const void *virtual_address, uint32 **ptr_page_table);
 
 //2016
@@ -101,6 +120,9 @@ void * create_page_table(uint32 *ptr_page_directory, const uint32 virtual_addres
 int	map_frame(uint32 *ptr_page_directory, struct Frame_Info *ptr_frame_info, void *virtual_address, int perm);
 void	unmap_frame(uint32 *pgdir, void *va);
 struct Frame_Info *get_frame_info(uint32 *ptr_page_directory, void *virtual_address, uint32 **ptr_page_table);
+int allocate_frames(uint32 numOfFrames, struct Linked_List *ptr_frames_list);
+void free_frames(struct Linked_List *ptr_frames_list);
+int map_frame_range(uint32 *ptr_page_directory, struct Linked_List *ptr_frames_list, void *virtual_address, uint32 numOfPages, int perm);
 void decrement_references(struct Frame_Info* ptr_frame_info);
 void initialize_frame_info(struct Frame_Info *ptr_frame_info);
 
@@ -131,7 +153,13 @@ void trim_all_environments();
 
 
 // WS helper functions ===================================================
+ uint32 env_page_ws_index_size(uint32 numOfElements);
+ void env_page_ws_initialize(struct Env *e, void *index);
  uint32 env_page_ws_get_size(struct Env *e);
+ uint32 env_page_ws_get_quota(struct Env *e);
+ int32 env_page_ws_find_empty_entry(struct Env *e);
+ int32 env_page_ws_lookup(struct Env *e, uint32 virtual_address);
+ int32 env_page_ws_get_oldest_entry(struct Env *e);
  void env_page_ws_invalidate(struct Env* e, uint32 virtual_address);
  void env_page_ws_set_entry(struct Env* e, uint32 entry_index, uint32 virtual_address);
  void env_page_ws_clear_entry(struct Env* e, uint32 entry_index);
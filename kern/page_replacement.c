@@ -0,0 +1,457 @@
+#include <inc/x86.h>
+#include <inc/stdio.h>
+#include <inc/assert.h>
+#include <kern/page_replacement.h>
+#include <kern/disk_queue.h>
+#include <kern/memory_manager.h>
+#include <kern/user_environment.h>
+#include <kern/kheap.h>
+
+// Per-algorithm statistics, indexed by PG_REP_XXX
+struct Page_Replacement_Stats pageReplacementStats[PG_REP_ARC + 1];
+
+struct Page_Replacement_Stats globalReplacementStats;
+uint32 globalReplacementNumOfStolenPages;
+// Position of the global clock hand
+static uint32 globalClockEnvIndex;
+static uint32 globalClockEntryIndex;
+
+#define ARC_NIL -1
+// Modified pages the ARC hands may pass over per replacement to find a clean victim
+#define ARC_MAX_MODIFIED_SKIPS 8
+// Same for the global clock hand
+#define GLOBAL_CLOCK_MAX_MODIFIED_SKIPS 8
+
+//==================================================================================//
+//============================== REPLACEMENT ENGINES ===============================//
+//==================================================================================//
+
+static uint32 page_replacement_fifo(struct Env *e, uint32 *numOfScannedEntries)
+{
+	(*numOfScannedEntries)++;
+	return env_page_ws_get_oldest_entry(e);
+}
+
+static uint32 page_replacement_clock(struct Env *e, uint32 *numOfScannedEntries)
+{
+	// Give each used page a second chance: clear its USED bit and move the hand to the next one.
+	// The scan stops within one round and a half of the WS at most
+	uint32 i = e->page_last_WS_index;
+	for (;; i = (i + 1) % e->page_WS_max_size)
+	{
+		if (env_page_ws_is_entry_empty(e, i))
+			continue;
+		(*numOfScannedEntries)++;
+		uint32 va = env_page_ws_get_virtual_address(e, i);
+		if (!(pt_get_page_permissions(e, va) & PERM_USED))
+			return i;
+		pt_set_page_permissions(e, va, 0, PERM_USED);
+	}
+}
+
+static uint32 page_replacement_lru(struct Env *e, uint32 *numOfScannedEntries)
+{
+	// The aging counters of all the entries are shifted at every clock tick (see update_WS_time_stamps()),
+	// so an ordering of the entries would have to be rebuilt at each tick: pick the minimum at fault time instead
+	uint32 victim = 0, minTimeStamp = 0xFFFFFFFF;
+	for (uint32 i = 0; i < e->page_WS_max_size; i++)
+	{
+		if (env_page_ws_is_entry_empty(e, i))
+			continue;
+		(*numOfScannedEntries)++;
+		uint32 timeStamp = env_page_ws_get_time_stamp(e, i);
+		if (timeStamp < minTimeStamp)
+		{
+			minTimeStamp = timeStamp;
+			victim = i;
+		}
+	}
+	return victim;
+}
+
+// Scan the WS circularly from page_last_WS_index for an entry with none of the given permissions.
+// If clearUsed is set, the USED bit of the skipped entries is cleared. Return -1 if there is no such entry
+static int page_replacement_mod_clock_scan(struct Env *e, uint32 perms, bool clearUsed, uint32 *numOfScannedEntries)
+{
+	for (uint32 n = 0, i = e->page_last_WS_index; n < e->page_WS_max_size; n++, i = (i + 1) % e->page_WS_max_size)
+	{
+		// [the spare entries of a WS with global replacement are empty]
+		if (env_page_ws_is_entry_empty(e, i))
+			continue;
+		(*numOfScannedEntries)++;
+		uint32 va = env_page_ws_get_virtual_address(e, i);
+		if (!(pt_get_page_permissions(e, va) & perms))
+			return i;
+		if (clearUsed)
+			pt_set_page_permissions(e, va, 0, PERM_USED);
+	}
+	return -1;
+}
+
+static uint32 page_replacement_modified_clock(struct Env *e, uint32 *numOfScannedEntries)
+{
+	int victim;
+	while (1)
+	{
+		// Try 1: a page that is neither used nor modified (without touching the USED bits)
+		if ((victim = page_replacement_mod_clock_scan(e, PERM_USED | PERM_MODIFIED, 0, numOfScannedEntries)) >= 0)
+			return victim;
+		// Try 2: a page that isn't used, clearing the USED bit of the skipped ones
+		if ((victim = page_replacement_mod_clock_scan(e, PERM_USED, 1, numOfScannedEntries)) >= 0)
+			return victim;
+	}
+}
+
+//==================================================================================//
+//================================== ARC [CAR] =====================================//
+//==================================================================================//
+
+// The hardware only gives a USED bit per page, so hits can't move a page to the MRU end of its list
+// as in ARC: T1 and T2 are clocks whose hands find the pages referenced since their last visit [CAR].
+// The lists are kept in the nodes of the ARC state: the WS entries are the resident nodes
+// and the ghosts remember the VAs of the pages evicted from T1 (B1) or T2 (B2).
+
+static void arc_append(struct ARC_State *s, uint32 list, int32 n)
+{
+	s->nodes[n].list = list;
+	s->nodes[n].next = ARC_NIL;
+	s->nodes[n].prev = s->tail[list];
+	if (s->tail[list] != ARC_NIL)
+		s->nodes[s->tail[list]].next = n;
+	else
+		s->head[list] = n;
+	s->tail[list] = n;
+	s->size[list]++;
+}
+
+static void arc_unlink(struct ARC_State *s, int32 n)
+{
+	uint32 list = s->nodes[n].list;
+	if (s->nodes[n].prev != ARC_NIL)
+		s->nodes[s->nodes[n].prev].next = s->nodes[n].next;
+	else
+		s->head[list] = s->nodes[n].next;
+	if (s->nodes[n].next != ARC_NIL)
+		s->nodes[s->nodes[n].next].prev = s->nodes[n].prev;
+	else
+		s->tail[list] = s->nodes[n].prev;
+	s->size[list]--;
+	s->nodes[n].list = ARC_NONE;
+}
+
+static inline uint32 arc_hash(struct ARC_State *s, uint32 va)
+{
+	uint32 vpn = va >> PGSHIFT;
+	return (vpn ^ (vpn >> 10)) & s->hashMask;
+}
+
+static int32 arc_ghost_lookup(struct ARC_State *s, uint32 va)
+{
+	int32 n = s->ghostHash[arc_hash(s, va)];
+	while (n != ARC_NIL && s->nodes[n].va != va)
+		n = s->nodes[n].hashNext;
+	return n;
+}
+
+// Forget the ghost node n
+static void arc_ghost_remove(struct ARC_State *s, int32 n)
+{
+	int32 *link = &s->ghostHash[arc_hash(s, s->nodes[n].va)];
+	while (*link != n)
+		link = &s->nodes[*link].hashNext;
+	*link = s->nodes[n].hashNext;
+
+	arc_unlink(s, n);
+	s->nodes[n].next = s->freeGhosts;
+	s->freeGhosts = n;
+}
+
+// Remember the evicted page va at the MRU end of the ghost list
+static void arc_ghost_add(struct ARC_State *s, uint32 list, uint32 va)
+{
+	if (s->freeGhosts == ARC_NIL)
+		arc_ghost_remove(s, s->head[s->size[ARC_B1] > 0 ? ARC_B1 : ARC_B2]);
+	int32 n = s->freeGhosts;
+	s->freeGhosts = s->nodes[n].next;
+
+	s->nodes[n].va = va;
+	uint32 bucket = arc_hash(s, va);
+	s->nodes[n].hashNext = s->ghostHash[bucket];
+	s->ghostHash[bucket] = n;
+	arc_append(s, list, n);
+}
+
+// Create the ARC state of e with all its resident pages in T1, in the order they were loaded
+static struct ARC_State *arc_create(struct Env *e)
+{
+	uint32 c = e->page_WS_max_size;
+	uint32 numOfBuckets = 8;
+	while (numOfBuckets < c)
+		numOfBuckets <<= 1;
+
+	struct ARC_State *s = kmalloc(sizeof(struct ARC_State) + 2 * c * sizeof(struct ARC_Node) + numOfBuckets * sizeof(int32));
+	if (s == NULL)
+		return NULL;
+	s->c = c;
+	s->p = 0;
+	for (int list = ARC_T1; list <= ARC_B2; list++)
+	{
+		s->head[list] = s->tail[list] = ARC_NIL;
+		s->size[list] = 0;
+	}
+	s->hashMask = numOfBuckets - 1;
+	s->ghostHash = (int32 *)&s->nodes[2 * c];
+	for (int i = 0; i < numOfBuckets; i++)
+		s->ghostHash[i] = ARC_NIL;
+
+	s->freeGhosts = ARC_NIL;
+	for (int n = 2 * c - 1; n >= 0; n--)
+	{
+		s->nodes[n].list = ARC_NONE;
+		if (n >= c)
+		{
+			s->nodes[n].next = s->freeGhosts;
+			s->freeGhosts = n;
+		}
+	}
+	for (int32 i = env_page_ws_get_oldest_entry(e); i != ARC_NIL; i = e->__pws_fifo_next[i])
+	{
+		arc_append(s, ARC_T1, i);
+		s->nodes[i].usedAtLoad = 0;
+	}
+
+	e->__pws_arc = s;
+	return s;
+}
+
+// Called after the given WS entry is loaded with a new page: a fault on a page of B1 (B2) means T1 (T2)
+// was too small, so its target grows before the page is put in T2
+void page_replacement_ws_entry_set(struct Env *e, uint32 entry_index)
+{
+	struct ARC_State *s = e->__pws_arc;
+	if (s == NULL)
+		return;
+
+	int32 g = arc_ghost_lookup(s, env_page_ws_get_virtual_address(e, entry_index));
+	if (g == ARC_NIL)
+	{
+		// keep |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c
+		if (s->size[ARC_T1] + s->size[ARC_B1] >= s->c && s->size[ARC_B1] > 0)
+			arc_ghost_remove(s, s->head[ARC_B1]);
+		else if (s->size[ARC_T1] + s->size[ARC_T2] + s->size[ARC_B1] + s->size[ARC_B2] >= 2 * s->c && s->size[ARC_B2] > 0)
+			arc_ghost_remove(s, s->head[ARC_B2]);
+		arc_append(s, ARC_T1, entry_index);
+		s->nodes[entry_index].usedAtLoad = 1;
+		return;
+	}
+
+	if (s->nodes[g].list == ARC_B1)
+	{
+		e->nARCGhostHitsB1++;
+		s->p = MIN(s->p + MAX(1, s->size[ARC_B2] / s->size[ARC_B1]), s->c);
+	}
+	else
+	{
+		e->nARCGhostHitsB2++;
+		uint32 delta = MAX(1, s->size[ARC_B1] / s->size[ARC_B2]);
+		s->p = (s->p > delta) ? s->p - delta : 0;
+	}
+	arc_ghost_remove(s, g);
+	arc_append(s, ARC_T2, entry_index);
+	s->nodes[entry_index].usedAtLoad = 1;
+}
+
+// Called when the given WS entry is emptied (the page is freed, or it's the victim that was already moved to a ghost list)
+void page_replacement_ws_entry_cleared(struct Env *e, uint32 entry_index)
+{
+	struct ARC_State *s = e->__pws_arc;
+	if (s != NULL && s->nodes[entry_index].list != ARC_NONE)
+		arc_unlink(s, entry_index);
+}
+
+// Called before the WS of e is reallocated with a new size: its ARC state is dropped and created again
+// (with the new size) at the next replacement
+void page_replacement_ws_resized(struct Env *e)
+{
+	if (e->__pws_arc != NULL)
+		kfree(e->__pws_arc);
+	e->__pws_arc = NULL;
+}
+
+static uint32 page_replacement_modified_clock(struct Env *e, uint32 *numOfScannedEntries);
+
+static uint32 page_replacement_arc(struct Env *e, uint32 *numOfScannedEntries)
+{
+	struct ARC_State *s = e->__pws_arc;
+	if (s == NULL && (s = arc_create(e)) == NULL)
+		return page_replacement_modified_clock(e, numOfScannedEntries);
+
+	// A modified page costs a page file write: let the hands pass over a few of them to find a clean victim
+	uint32 modifiedSkipsLeft = ARC_MAX_MODIFIED_SKIPS;
+	while (1)
+	{
+		uint32 list = (s->size[ARC_T1] >= MAX(1, s->p) || s->size[ARC_T2] == 0) ? ARC_T1 : ARC_T2;
+		int32 n = s->head[list];
+		(*numOfScannedEntries)++;
+
+		uint32 va = env_page_ws_get_virtual_address(e, n);
+		uint32 perm = pt_get_page_permissions(e, va);
+		arc_unlink(s, n);
+		if ((perm & PERM_USED) && s->nodes[n].usedAtLoad)
+		{
+			// the page is seen as used by the access that loaded it: wait for another round to tell
+			// whether it's used again, so that pages that are scanned once don't go to T2
+			s->nodes[n].usedAtLoad = 0;
+			pt_set_page_permissions(e, va, 0, PERM_USED);
+			arc_append(s, list, n);
+		}
+		else if (perm & PERM_USED)
+		{
+			// used again since the hand passed it: T1 -> T2, or another round in T2
+			e->nARCHits++;
+			pt_set_page_permissions(e, va, 0, PERM_USED);
+			arc_append(s, ARC_T2, n);
+		}
+		else if ((perm & PERM_MODIFIED) && modifiedSkipsLeft > 0)
+		{
+			modifiedSkipsLeft--;
+			arc_append(s, list, n);
+		}
+		else
+		{
+			arc_ghost_add(s, (list == ARC_T1) ? ARC_B1 : ARC_B2, va);
+			return n;
+		}
+	}
+}
+
+uint32 (*pageReplacementEngines[])(struct Env *e, uint32 *numOfScannedEntries) =
+	{
+		[PG_REP_LRU] = page_replacement_lru,
+		[PG_REP_CLOCK] = page_replacement_clock,
+		[PG_REP_FIFO] = page_replacement_fifo,
+		[PG_REP_MODIFIEDCLOCK] = page_replacement_modified_clock,
+		[PG_REP_ARC] = page_replacement_arc,
+};
+
+//==================================================================================//
+//=============================== VICTIM SELECTION =================================//
+//==================================================================================//
+
+// Return the index of the WS entry of e to be replaced using the current replacement algorithm [the WS must be full]
+uint32 select_WS_victim(struct Env *e)
+{
+	assert(env_page_ws_get_size(e) == env_page_ws_get_quota(e));
+
+	uint32 algorithm = (_PageRepAlgoType >= PG_REP_LRU && _PageRepAlgoType <= PG_REP_ARC) ? _PageRepAlgoType : PG_REP_MODIFIEDCLOCK;
+	struct Page_Replacement_Stats *stats = &pageReplacementStats[algorithm];
+	uint64 startCycles = read_tsc();
+
+	uint32 victim = pageReplacementEngines[algorithm](e, &stats->numOfScannedEntries);
+
+	stats->totalCycles += read_tsc() - startCycles;
+	stats->numOfVictims++;
+	if (pt_get_page_permissions(e, env_page_ws_get_virtual_address(e, victim)) & PERM_MODIFIED)
+		stats->numOfModifiedVictims++;
+	return victim;
+}
+
+// Return the env whose WS entries can be taken by the global clock at a fault of e
+static uint8 is_global_victim_env(struct Env *e, struct Env *candidate)
+{
+	if (candidate == e)
+		return 1;
+	// [the page of an env blocked on a page-file read is being read by the disk interrupt]
+	return (candidate->env_status == ENV_READY || candidate->env_status == ENV_BLOCKED) &&
+		   env_page_ws_get_quota(candidate) > GLOBAL_REPLACEMENT_MIN_WS_SIZE && !disk_queue_has_request(candidate);
+}
+
+// Return the env of the page to be replaced at a fault of e [its WS must be full] and set entry_index to its WS
+// entry, using the global clock
+struct Env *select_global_victim(struct Env *e, uint32 *entry_index)
+{
+	assert(env_page_ws_get_size(e) == env_page_ws_get_quota(e));
+	uint64 startCycles = read_tsc();
+
+	// The hand stops within two rounds over the WSs at most: e is always there and it's full
+	uint32 modifiedSkipsLeft = GLOBAL_CLOCK_MAX_MODIFIED_SKIPS;
+	struct Env *victimEnv = NULL;
+	while (victimEnv == NULL)
+	{
+		struct Env *candidate = &envs[globalClockEnvIndex];
+		if (!is_global_victim_env(e, candidate) || globalClockEntryIndex >= candidate->page_WS_max_size)
+		{
+			globalClockEnvIndex = (globalClockEnvIndex + 1) % NENV;
+			globalClockEntryIndex = 0;
+			continue;
+		}
+
+		uint32 i = globalClockEntryIndex++;
+		if (env_page_ws_is_entry_empty(candidate, i))
+			continue;
+		globalReplacementStats.numOfScannedEntries++;
+
+		uint32 va = env_page_ws_get_virtual_address(candidate, i);
+		uint32 perm = pt_get_page_permissions(candidate, va);
+		if (perm & PERM_USED)
+			pt_set_page_permissions(candidate, va, 0, PERM_USED);
+		else if ((perm & PERM_MODIFIED) && modifiedSkipsLeft > 0)
+			modifiedSkipsLeft--;
+		else
+		{
+			victimEnv = candidate;
+			*entry_index = i;
+			if (perm & PERM_MODIFIED)
+				globalReplacementStats.numOfModifiedVictims++;
+		}
+	}
+
+	globalReplacementStats.totalCycles += read_tsc() - startCycles;
+	globalReplacementStats.numOfVictims++;
+	if (victimEnv != e)
+		globalReplacementNumOfStolenPages++;
+	return victimEnv;
+}
+
+void page_replacement_print_statistics()
+{
+	char *names[] = {"", "LRU", "CLOCK", "FIFO", "MOD. CLOCK", "ARC"};
+
+	for (int i = PG_REP_LRU; i <= PG_REP_ARC; i++)
+	{
+		struct Page_Replacement_Stats *stats = &pageReplacementStats[i];
+		uint32 avgScanned = (stats->numOfVictims > 0) ? stats->numOfScannedEntries / stats->numOfVictims : 0;
+		uint32 avgCycles = (stats->numOfVictims > 0) ? (uint32)(stats->totalCycles / stats->numOfVictims) : 0;
+		cprintf("%s:\tvictims = %d (modified = %d), avg. scanned entries/victim = %d, avg. cycles/victim = %d\n",
+				names[i], stats->numOfVictims, stats->numOfModifiedVictims, avgScanned, avgCycles);
+	}
+	{
+		struct Page_Replacement_Stats *stats = &globalReplacementStats;
+		uint32 avgScanned = (stats->numOfVictims > 0) ? stats->numOfScannedEntries / stats->numOfVictims : 0;
+		uint32 avgCycles = (stats->numOfVictims > 0) ? (uint32)(stats->totalCycles / stats->numOfVictims) : 0;
+		cprintf("GLOBAL:\tvictims = %d (modified = %d, of other programs = %d), avg. scanned entries/victim = %d, avg. cycles/victim = %d\n",
+				stats->numOfVictims, stats->numOfModifiedVictims, globalReplacementNumOfStolenPages, avgScanned, avgCycles);
+	}
+
+	// page faults of the programs in memory, to compare the local and the global replacement
+	uint32 totalFaults = 0;
+	for (struct Env *e = envs; e < envs + NENV; e++)
+	{
+		if (e->env_status == ENV_FREE)
+			continue;
+		cprintf("[%d] %s:	WS size = %d, page faults = %d\n", e->env_id, e->prog_name, env_page_ws_get_quota(e), e->pageFaultsCounter);
+		totalFaults += e->pageFaultsCounter;
+	}
+	cprintf("Replacement is %s, total page faults = %d\n", isPageReplacmentGlobal() ? "GLOBAL" : "LOCAL", totalFaults);
+
+	// ARC counters of the environments that have used it
+	for (struct Env *e = envs; e < envs + NENV; e++)
+	{
+		if (e->env_status == ENV_FREE || e->__pws_arc == NULL)
+			continue;
+		struct ARC_State *s = e->__pws_arc;
+		cprintf("[%d] %s:\tARC hits = %d, B1 ghost hits = %d, B2 ghost hits = %d, |T1| = %d (target %d), |T2| = %d, |B1| = %d, |B2| = %d\n",
+				e->env_id, e->prog_name, e->nARCHits, e->nARCGhostHitsB1, e->nARCGhostHitsB2,
+				s->size[ARC_T1], s->p, s->size[ARC_T2], s->size[ARC_B1], s->size[ARC_B2]);
+	}
+}
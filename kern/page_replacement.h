@@ -0,0 +1,80 @@
+#ifndef FOS_KERN_PAGE_REPLACEMENT_H_
+#define FOS_KERN_PAGE_REPLACEMENT_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/environment_definitions.h>
+#include <kern/trap.h>
+
+// Page replacement engines, one per PG_REP_XXX algorithm.
+// Each engine is called when the page WS of an environment is full and returns the index of
+// the WS entry to be replaced; numOfScannedEntries is increased by the entries it examined.
+//	FIFO:			the head of the WS load-order queue
+//	CLOCK:			second chance on the USED bit, starting at page_last_WS_index
+//	LRU:			the entry with the smallest aging counter (time_stamp)
+//	Modified CLOCK:	a not-used & not-modified entry first, then the CLOCK scan
+//	ARC:			CLOCK with adaptive replacement [CAR]: two clocks, T1 for the pages used once since
+//					they were loaded and T2 for the pages used again, whose target sizes adapt to
+//					the faults on the recently evicted pages remembered in the ghost lists B1 and B2
+
+struct Page_Replacement_Stats
+{
+	uint32 numOfVictims;
+	uint32 numOfModifiedVictims;
+	uint32 numOfScannedEntries;
+	uint64 totalCycles;
+};
+
+extern struct Page_Replacement_Stats pageReplacementStats[PG_REP_ARC + 1];
+
+// Global replacement: one clock hand goes over the WS entries of the faulting environment and of all the
+// READY/BLOCKED ones, giving a second chance to the used pages (and to a few modified ones).
+// A victim of another environment moves its WS entry to the faulting one [see the page fault handler]
+// unless that environment is down to GLOBAL_REPLACEMENT_MIN_WS_SIZE pages.
+#define GLOBAL_REPLACEMENT_MIN_WS_SIZE 4
+
+// The quota of a WS moves with the pages taken by global replacement, but its array is reallocated only once per
+// this many entries [see env_page_ws_grow_quota()/env_page_ws_trim()]
+#define GLOBAL_REPLACEMENT_WS_GROW_STEP 8
+
+extern struct Page_Replacement_Stats globalReplacementStats;
+extern uint32 globalReplacementNumOfStolenPages; // victims taken from another environment
+
+#define ARC_T1 0
+#define ARC_T2 1
+#define ARC_B1 2
+#define ARC_B2 3
+#define ARC_NONE 4
+
+struct ARC_Node
+{
+	int32 next, prev; // in the list of the node
+	uint8 list;		  // ARC_XXX
+	uint8 usedAtLoad; // resident nodes: the USED bit may still be the one of the faulting access
+	uint32 va;		  // ghost nodes only (resident nodes use their WS entry)
+	int32 hashNext;	  // ghost nodes only
+};
+
+struct ARC_State
+{
+	uint32 c; // WS size
+	uint32 p; // target size of T1
+	int32 head[4], tail[4];
+	uint32 size[4];
+	int32 freeGhosts;
+	uint32 hashMask;
+	int32 *ghostHash;
+	struct ARC_Node nodes[]; // [0, c) = WS entries, [c, 2c) = ghosts
+};
+
+uint32 select_WS_victim(struct Env *e);
+struct Env *select_global_victim(struct Env *e, uint32 *entry_index);
+void page_replacement_ws_entry_set(struct Env *e, uint32 entry_index);
+void page_replacement_ws_entry_cleared(struct Env *e, uint32 entry_index);
+void page_replacement_ws_resized(struct Env *e);
+void page_replacement_print_statistics();
+
+#endif // FOS_KERN_PAGE_REPLACEMENT_H_
@@ -0,0 +1,65 @@
+#include <inc/stdio.h>
+#include <inc/error.h>
+#include <kern/pff.h>
+#include <kern/user_environment.h>
+#include <kern/memory_manager.h>
+
+void pff_enable(uint32 minWSSize, uint32 maxWSSize, uint32 highFaults, uint32 lowFaults)
+{
+	pffMinWSSize = MAX(minWSSize, 1);
+	pffMaxWSSize = MAX(maxWSSize, pffMinWSSize);
+	pffHighFaultsPerQuantum = highFaults;
+	pffLowFaultsPerQuantum = MIN(lowFaults, highFaults);
+	_PFFEnabled = 1;
+}
+void pff_disable() { _PFFEnabled = 0; }
+uint8 isPFFEnabled() { return _PFFEnabled; }
+
+// Called at the end of each quantum of e [clock interrupt]: resize its WS according to its fault rate
+void pff_on_clock(struct Env *e)
+{
+	if (!isPFFEnabled() || e == NULL)
+		return;
+
+	uint32 numOfFaults = e->pageFaultsCounter - e->pffLastPageFaultsCounter;
+	e->pffLastPageFaultsCounter = e->pageFaultsCounter;
+
+	uint32 size = env_page_ws_get_quota(e);
+	uint32 step = MAX(size / 8, 1);
+	uint32 newSize = size;
+	if (numOfFaults > pffHighFaultsPerQuantum)
+	{
+		e->pffNumOfQuietQuanta = 0;
+		newSize = MIN(size + step, pffMaxWSSize);
+	}
+	else if (numOfFaults <= pffLowFaultsPerQuantum && ++e->pffNumOfQuietQuanta >= PFF_QUIET_QUANTA)
+	{
+		e->pffNumOfQuietQuanta = 0;
+		newSize = MAX(size - MIN(step, size), pffMinWSSize);
+	}
+
+	// an out of bounds WS (e.g. created before the bounds were set) is brought back in bounds
+	newSize = MIN(MAX(newSize, pffMinWSSize), pffMaxWSSize);
+	if (newSize == size || env_page_ws_resize(e, newSize) != 0)
+		return;
+	if (newSize > size)
+		e->pffNumOfGrows++;
+	else
+		e->pffNumOfShrinks++;
+}
+
+void pff_print_statistics()
+{
+	if (isPFFEnabled())
+		cprintf("PFF: WS size in [%d, %d], grow above %d faults/quantum, shrink at %d faults/quantum for %d quanta\n",
+				pffMinWSSize, pffMaxWSSize, pffHighFaultsPerQuantum, pffLowFaultsPerQuantum, PFF_QUIET_QUANTA);
+	else
+		cprintf("PFF is disabled\n");
+	for (struct Env *e = envs; e < envs + NENV; e++)
+	{
+		if (e->env_status == ENV_FREE)
+			continue;
+		cprintf("[%d] %s:\tWS size = %d, page faults = %d, grows = %d, shrinks = %d\n",
+				e->env_id, e->prog_name, env_page_ws_get_quota(e), e->pageFaultsCounter, e->pffNumOfGrows, e->pffNumOfShrinks);
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef FOS_KERN_PFF_H_
+#define FOS_KERN_PFF_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/environment_definitions.h>
+
+// Page fault frequency (PFF) sizing of the page working sets: at the end of each quantum of an environment,
+// its number of page faults in that quantum is compared to two thresholds. Above the high one, its WS
+// grows by an eighth (at least 1 page); at or below the low one for PFF_QUIET_QUANTA quanta in a row, it
+// shrinks by an eighth. The WS size is kept in [pffMinWSSize, pffMaxWSSize].
+
+#define PFF_QUIET_QUANTA 4
+#define PFF_DEFAULT_HIGH_FAULTS 4
+#define PFF_DEFAULT_LOW_FAULTS 0
+
+uint8 _PFFEnabled;
+uint32 pffMinWSSize;
+uint32 pffMaxWSSize;
+uint32 pffHighFaultsPerQuantum;
+uint32 pffLowFaultsPerQuantum;
+
+void pff_enable(uint32 minWSSize, uint32 maxWSSize, uint32 highFaults, uint32 lowFaults);
+void pff_disable();
+uint8 isPFFEnabled();
+
+void pff_on_clock(struct Env *e);
+void pff_print_statistics();
+
+#endif // FOS_KERN_PFF_H_
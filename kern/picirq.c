@@ -7,6 +7,8 @@
 // Current IRQ mask.
 // Initial IRQ mask has interrupt 2 enabled (for slave 8259A).
 uint16 irq_mask_8259A = 0xFFFF & ~(1 << IRQ_SLAVE);
+// IRQs of the devices to unmask with the clock IRQ [e.g. the disk IRQ, see kern/disk_queue.c]
+uint16 irq_devices_8259A = 0;
 static bool didinit;
 
 /* Initialize the 8259A interrupt controllers. */
@@ -21,6 +21,7 @@
 #include <inc/x86.h>
 
 extern uint16 irq_mask_8259A;
+extern uint16 irq_devices_8259A; // IRQs of the devices enabled with the clock while an env runs
 void pic_init(void);
 void irq_setmask_8259A(uint16 mask);
 
@@ -0,0 +1,66 @@
+#include <inc/mmu.h>
+#include <inc/stdio.h>
+#include <kern/readahead.h>
+#include <kern/memory_manager.h>
+#include <kern/user_environment.h>
+
+void setReadaheadMaxWindow(uint32 numOfPages) { _ReadaheadMaxWindow = MIN(numOfPages, READAHEAD_MAX_WINDOW); }
+uint32 getReadaheadMaxWindow() { return _ReadaheadMaxWindow; }
+
+// Called at each page fault of e: update its fault stream and return the number of pages to read ahead
+// with the faulted page, every stride pages
+uint32 readahead_on_fault(struct Env *e, uint32 fault_va, int32 *stride)
+{
+	fault_va = ROUNDDOWN(fault_va, PAGE_SIZE);
+
+	// the pages read ahead at the last fault are hits if they were used since then
+	for (uint32 k = 1; k <= e->raLastNumOfPages; k++)
+	{
+		uint32 va = e->raLastFaultVA + k * e->raStride * PAGE_SIZE;
+		if ((pt_get_page_permissions(e, va) & (PERM_PRESENT | PERM_USED)) == (PERM_PRESENT | PERM_USED))
+			e->raNumOfHits++;
+	}
+
+	// the next fault of a stream comes right after the pages read ahead for it
+	int32 delta = ((int32)fault_va - (int32)e->raLastFaultVA) / PAGE_SIZE;
+	if (e->raStride != 0 && delta == e->raStride * (int32)(1 + e->raLastNumOfPages))
+	{
+		e->raWindow = (e->raWindow == 0) ? 1 : MIN(2 * e->raWindow, getReadaheadMaxWindow());
+	}
+	else if (e->raStride != 0 && delta == e->raStride)
+	{
+		// the stream goes on but didn't use what was read ahead
+		e->raWindow /= 2;
+	}
+	else
+	{
+		// a new stream: follow its stride from its next fault
+		e->raStride = (delta != 0 && delta >= -READAHEAD_MAX_STRIDE && delta <= READAHEAD_MAX_STRIDE) ? delta : 0;
+		e->raWindow = 0;
+	}
+	e->raLastFaultVA = fault_va;
+	e->raLastNumOfPages = 0;
+
+	*stride = e->raStride;
+	return e->raWindow;
+}
+
+// Record the number of pages that were actually read ahead at the last fault of e
+void readahead_done(struct Env *e, uint32 numOfPages)
+{
+	e->raLastNumOfPages = numOfPages;
+	e->raNumOfPages += numOfPages;
+}
+
+void readahead_print_statistics()
+{
+	cprintf("Readahead max window = %d pages (max %d)\n", getReadaheadMaxWindow(), READAHEAD_MAX_WINDOW);
+	for (struct Env *e = envs; e < envs + NENV; e++)
+	{
+		if (e->env_status == ENV_FREE || e->raNumOfPages == 0)
+			continue;
+		cprintf("[%d] %s:\tstride = %d, window = %d, pages read ahead = %d, hits = %d (%d%%)\n",
+				e->env_id, e->prog_name, e->raStride, e->raWindow, e->raNumOfPages, e->raNumOfHits,
+				(e->raNumOfHits * 100) / e->raNumOfPages);
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef FOS_KERN_READAHEAD_H_
+#define FOS_KERN_READAHEAD_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/memlayout.h>
+#include <inc/environment_definitions.h>
+
+// Adaptive readahead: each environment follows the stride (in pages) between its page faults.
+// When a fault continues the current stream, the window of pages read ahead with the faulted page
+// doubles (up to _ReadaheadMaxWindow); when the stream breaks, it shrinks by half or restarts.
+// Pages are read ahead into empty WS entries only, so readahead never evicts resident pages.
+
+#define READAHEAD_MAX_STRIDE 16 // largest stride (in pages) followed by the detector
+#define READAHEAD_MAX_WINDOW (KERNEL_DISK_WINDOW_PAGES - 1) // the faulted page and its window are read by one batch
+
+uint32 _ReadaheadMaxWindow; // 0 = disabled
+
+void setReadaheadMaxWindow(uint32 numOfPages);
+uint32 getReadaheadMaxWindow();
+
+uint32 readahead_on_fault(struct Env *e, uint32 fault_va, int32 *stride);
+void readahead_done(struct Env *e, uint32 numOfPages);
+void readahead_print_statistics();
+
+#endif // FOS_KERN_READAHEAD_H_
@@ -6,7 +6,12 @@
 #include <kern/command_prompt.h>
 #include <kern/trap.h>
 #include <kern/kheap.h>
+#include <kern/slab.h>
 #include <kern/utilities.h>
+#include <kern/writeback.h>
+#include <kern/pff.h>
+#include <kern/load_control.h>
+#include <kern/disk_queue.h>
 
 // void on_clock_update_WS_time_stamps();
 extern uint32 isBufferingEnabled();
@@ -142,7 +147,12 @@ void fos_scheduler(void)
 			enqueue(&(env_ready_queues[0]), curenv);
 		}
 
-		// Pick the next environment from the ready queue
+		// Pick the next environment from the ready queue [if there's nothing else to run: wait for the envs
+		// blocked on their page-file reads, then re-admit a suspended one]
+		if (LIST_EMPTY(&(env_ready_queues[0])))
+			disk_queue_drain();
+		if (LIST_EMPTY(&(env_ready_queues[0])))
+			sched_readmit_suspended();
 		next_env = dequeue(&(env_ready_queues[0]));
 
 		// Reset the quantum
@@ -192,29 +202,41 @@ void sched_init_RR(uint8 quantum)
 
 	// Create 1 ready queue for the RR
 	num_of_ready_queues = 1;
-	env_ready_queues = kmalloc(sizeof(struct Env_Queue));
-	quantums = kmalloc(num_of_ready_queues * sizeof(uint8));
+	env_ready_queues = kmem_cache_alloc(env_queues_cache);
+	quantums = kmem_cache_alloc(quantums_cache);
 	quantums[0] = quantum;
 	kclock_set_quantum(quantums[0]);
-	init_queue(&(env_ready_queues[0]));
+}
+
+// Constructor of the "Env_Queue" object cache
+static void env_queue_ctor(void *obj)
+{
+	init_queue((struct Env_Queue *)obj);
 }
 
 void sched_init()
 {
 	old_pf_counter = 0;
 
+	// Ready queue(s) and quantum(s) are tiny objects: serve them from object caches instead of whole kernel heap pages
+	env_queues_cache = kmem_cache_create("Env_Queue", sizeof(struct Env_Queue), env_queue_ctor);
+	quantums_cache = kmem_cache_create("quantums", sizeof(uint8), NULL);
+
 	sched_init_RR(CLOCK_INTERVAL_IN_MS);
 
 	init_queue(&env_new_queue);
 	init_queue(&env_exit_queue);
+	init_queue(&env_suspended_queue);
 }
 
 void sched_delete_ready_queues()
 {
 	if (env_ready_queues != NULL)
-		kfree(env_ready_queues);
+		kmem_cache_free(env_queues_cache, env_ready_queues);
 	if (quantums != NULL)
-		kfree(quantums);
+		kmem_cache_free(quantums_cache, quantums);
+	env_ready_queues = NULL;
+	quantums = NULL;
 }
 void sched_insert_ready(struct Env *env)
 {
@@ -280,6 +302,36 @@ void sched_remove_exit(struct Env *env)
 	}
 }
 
+void sched_insert_suspended(struct Env *env)
+{
+	if (env != NULL)
+	{
+		env->env_status = ENV_SUSPENDED;
+		enqueue(&env_suspended_queue, env);
+	}
+}
+void sched_remove_suspended(struct Env *env)
+{
+	if (env != NULL)
+	{
+		LIST_REMOVE(&env_suspended_queue, env);
+		env->env_status = ENV_UNKNOWN;
+	}
+}
+
+// Move the env that was suspended first back to the READY queue [its pages are brought back by its page faults]
+struct Env *sched_readmit_suspended()
+{
+	struct Env *env = LIST_LAST(&env_suspended_queue);
+	if (env != NULL)
+	{
+		sched_remove_suspended(env);
+		sched_insert_ready(env);
+		loadControlNumOfReadmissions++;
+	}
+	return env;
+}
+
 void sched_print_all()
 {
 	struct Env *ptr_env;
@@ -312,6 +364,19 @@ void sched_print_all()
 		}
 		cprintf("================================================\n");
 	}
+	if (!LIST_EMPTY(&env_suspended_queue))
+	{
+		cprintf("The processes in SUSPENDED queue are:\n");
+		LIST_FOREACH(ptr_env, &env_suspended_queue)
+		{
+			cprintf("	[%d] %s (swapped out %d times)\n", ptr_env->env_id, ptr_env->prog_name, ptr_env->nSwapOuts);
+		}
+	}
+	else
+	{
+		cprintf("No processes in SUSPENDED queue\n");
+	}
+	cprintf("================================================\n");
 	if (!LIST_EMPTY(&env_exit_queue))
 	{
 		cprintf("The processes in EXIT queue are:\n");
@@ -341,6 +406,8 @@ void sched_run_all()
 
 void sched_kill_all()
 {
+	// the envs blocked on their page-file reads are back in the READY queue after it's drained
+	disk_queue_drain();
 	struct Env *ptr_env;
 	if (!LIST_EMPTY(&env_new_queue))
 	{
@@ -378,6 +445,23 @@ void sched_kill_all()
 		cprintf("================================================\n");
 	}
 
+	if (!LIST_EMPTY(&env_suspended_queue))
+	{
+		cprintf("KILLING the processes in the SUSPENDED queue...\n");
+		LIST_FOREACH(ptr_env, &env_suspended_queue)
+		{
+			cprintf("	killing[%d] %s...", ptr_env->env_id, ptr_env->prog_name);
+			sched_remove_suspended(ptr_env);
+			start_env_free(ptr_env);
+			cprintf("DONE\n");
+		}
+	}
+	else
+	{
+		cprintf("No processes in SUSPENDED queue\n");
+	}
+	cprintf("================================================\n");
+
 	if (!LIST_EMPTY(&env_exit_queue))
 	{
 		cprintf("KILLING the processes in the EXIT queue...\n");
@@ -482,6 +566,18 @@ void sched_exit_env(uint32 envId)
 		}
 	}
 	if (!found)
+	{
+		LIST_FOREACH(ptr_env, &env_suspended_queue)
+		{
+			if (ptr_env->env_id == envId)
+			{
+				sched_remove_suspended(ptr_env);
+				found = 1;
+				break;
+			}
+		}
+	}
+	if (!found)
 	{
 		if (curenv->env_id == envId)
 		{
@@ -506,6 +602,8 @@ void sched_exit_env(uint32 envId)
 /*2018*/
 void sched_exit_all_ready_envs()
 {
+	// the envs blocked on their page-file reads are back in the READY queue after it's drained
+	disk_queue_drain();
 	struct Env *ptr_env = NULL;
 	for (int i = 0; i < num_of_ready_queues; i++)
 	{
@@ -524,6 +622,8 @@ void sched_exit_all_ready_envs()
 /*2015*/
 void sched_kill_env(uint32 envId)
 {
+	// the envs blocked on their page-file reads are back in the READY queue after it's drained
+	disk_queue_drain();
 	struct Env *ptr_env = NULL;
 	int found = 0;
 	if (!found)
@@ -567,6 +667,22 @@ void sched_kill_env(uint32 envId)
 		}
 	}
 	if (!found)
+	{
+		ptr_env = NULL;
+		LIST_FOREACH(ptr_env, &env_suspended_queue)
+		{
+			if (ptr_env->env_id == envId)
+			{
+				cprintf("killing[%d] %s from the SUSPENDED queue...", ptr_env->env_id, ptr_env->prog_name);
+				sched_remove_suspended(ptr_env);
+				start_env_free(ptr_env);
+				cprintf("DONE\n");
+				found = 1;
+				break;
+			}
+		}
+	}
+	if (!found)
 	{
 		ptr_env = NULL;
 		LIST_FOREACH(ptr_env, &env_exit_queue)
@@ -614,6 +730,10 @@ void clock_interrupt_handler()
 	{
 		update_WS_time_stamps();
 	}
+	pff_on_clock(curenv);
+	env_page_ws_trim(curenv);
+	load_control_on_clock();
+	writeback_on_clock();
 	// cprintf("Clock Handler\n") ;
 	fos_scheduler();
 }
@@ -21,10 +21,13 @@ LIST_HEAD(Env_list, Env);  // Declares 'struct Env_list'
 struct Env_Queue env_new_queue; // queue of all new envs
 // 2015:
 struct Env_Queue env_exit_queue; // queue of all exited envs
+struct Env_Queue env_suspended_queue; // queue of the envs swapped out by the load control
 // 2018:
 struct Env_Queue *env_ready_queues; // Ready queue(s) for the MLFQ or RR
 uint8 *quantums;                    // Quantum(s) in ms for each level of the ready queue(s)
 uint8 num_of_ready_queues;          // Number of ready queue(s)
+struct Kmem_Cache *env_queues_cache; // Object cache of the ready queue(s)
+struct Kmem_Cache *quantums_cache;   // Object cache of the quantum(s)
 //===============
 
 // 2015
@@ -60,6 +63,9 @@ void sched_insert_exit(struct Env *env);
 void sched_remove_exit(struct Env *env);
 void sched_kill_env(uint32 envId);
 void sched_kill_all();
+void sched_insert_suspended(struct Env *env);
+void sched_remove_suspended(struct Env *env);
+struct Env *sched_readmit_suspended();
 
 // 2018:
 // Declaration of helper functions to deal with the env queues
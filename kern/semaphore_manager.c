@@ -79,16 +79,25 @@ int allocate_semaphore_object(struct Semaphore **allocatedObject)
 		// try to double the size of the "semaphores" array
 		if (USE_KHEAP == 1)
 		{
-			semaphores = (struct Semaphore *)krealloc(semaphores, 2 * MAX_SEMAPHORES);
-			if (semaphores == NULL)
+			struct Semaphore *newSemaphores = (struct Semaphore *)krealloc(semaphores, 2 * MAX_SEMAPHORES * sizeof(struct Semaphore));
+			if (newSemaphores == NULL)
 			{
+				// the old array remains valid
 				*allocatedObject = NULL;
 				return E_NO_SEMAPHORE;
 			}
 			else
 			{
+				semaphores = newSemaphores;
 				semaphoreObjectID = MAX_SEMAPHORES;
 				MAX_SEMAPHORES *= 2;
+				// initialize the new half of the array
+				for (int i = semaphoreObjectID; i < MAX_SEMAPHORES; ++i)
+				{
+					memset(&(semaphores[i]), 0, sizeof(struct Semaphore));
+					semaphores[i].empty = 1;
+					LIST_INIT(&(semaphores[i].env_queue));
+				}
 			}
 		}
 		else
@@ -61,16 +61,24 @@ int allocate_share_object(struct Share **allocatedObject)
 		// try to increase double the size of the "shares" array
 		if (USE_KHEAP == 1)
 		{
-			shares = krealloc(shares, 2 * MAX_SHARES);
-			if (shares == NULL)
+			struct Share *newShares = krealloc(shares, 2 * MAX_SHARES * sizeof(struct Share));
+			if (newShares == NULL)
 			{
+				// the old array remains valid
 				*allocatedObject = NULL;
 				return E_NO_SHARE;
 			}
 			else
 			{
+				shares = newShares;
 				sharedObjectID = MAX_SHARES;
 				MAX_SHARES *= 2;
+				// initialize the new half of the array
+				for (int i = sharedObjectID; i < MAX_SHARES; ++i)
+				{
+					memset(&(shares[i]), 0, sizeof(struct Share));
+					shares[i].empty = 1;
+				}
 			}
 		}
 		else
@@ -0,0 +1,160 @@
+#include <inc/memlayout.h>
+#include <inc/string.h>
+#include <inc/stdio.h>
+#include <inc/assert.h>
+#include <kern/slab.h>
+#include <kern/kheap.h>
+
+struct Kmem_Cache kmemCaches[KMEM_MAX_CACHES];
+
+// Maximum number of completely free slabs kept per cache before giving pages back to the kernel heap
+#define KMEM_MAX_EMPTY_SLABS 1
+
+//==================================================================================//
+//============================== HELPER FUNCTIONS ==================================//
+//==================================================================================//
+
+static struct Kmem_Slab *kmem_slab_create(struct Kmem_Cache *cache)
+{
+	struct Kmem_Slab *slab = kmalloc(PAGE_SIZE);
+	if (slab == NULL)
+		return NULL;
+
+	slab->cache = cache;
+	slab->numOfInUseObjs = 0;
+	slab->freeObjs = NULL;
+
+	// Link all the objects of the slab in its free list (lowest address first)
+	uint8 *firstObj = (uint8 *)slab + ROUNDUP(sizeof(struct Kmem_Slab), sizeof(uint32));
+	for (int i = cache->objsPerSlab - 1; i >= 0; i--)
+	{
+		void **obj = (void **)(firstObj + i * cache->objSize);
+		*obj = slab->freeObjs;
+		slab->freeObjs = obj;
+	}
+	return slab;
+}
+
+//==================================================================================//
+//================================ OBJECT CACHES ===================================//
+//==================================================================================//
+
+// Create a cache of objects of the given size, or return the existing cache
+// that has the same name and size
+struct Kmem_Cache *kmem_cache_create(char *name, uint32 objSize, void (*ctor)(void *obj))
+{
+	objSize = ROUNDUP(objSize < sizeof(void *) ? sizeof(void *) : objSize, sizeof(uint32));
+	if (objSize > KMEM_MAX_OBJ_SIZE)
+	{
+		cprintf("kmem_cache_create: object size of cache \"%s\" is too large for a slab!\n", name);
+		return NULL;
+	}
+
+	struct Kmem_Cache *cache = NULL;
+	for (int i = 0; i < KMEM_MAX_CACHES; i++)
+	{
+		if (kmemCaches[i].used && kmemCaches[i].objSize == objSize && strcmp(kmemCaches[i].name, name) == 0)
+			return &kmemCaches[i];
+		if (!kmemCaches[i].used && cache == NULL)
+			cache = &kmemCaches[i];
+	}
+	if (cache == NULL)
+	{
+		cprintf("kmem_cache_create: no more caches can be created!\n");
+		return NULL;
+	}
+
+	memset(cache, 0, sizeof(struct Kmem_Cache));
+	strncpy(cache->name, name, KMEM_CACHE_NAME_LEN - 1);
+	cache->objSize = objSize;
+	cache->objsPerSlab = (PAGE_SIZE - ROUNDUP(sizeof(struct Kmem_Slab), sizeof(uint32))) / objSize;
+	cache->ctor = ctor;
+	LIST_INIT(&cache->partialSlabs);
+	LIST_INIT(&cache->fullSlabs);
+	LIST_INIT(&cache->emptySlabs);
+	cache->used = 1;
+	return cache;
+}
+
+void *kmem_cache_alloc(struct Kmem_Cache *cache)
+{
+	struct Kmem_Slab *slab = LIST_FIRST(&cache->partialSlabs);
+	if (slab == NULL)
+	{
+		slab = LIST_FIRST(&cache->emptySlabs);
+		if (slab != NULL)
+			LIST_REMOVE(&cache->emptySlabs, slab);
+		else if ((slab = kmem_slab_create(cache)) == NULL)
+		{
+			cache->numOfFailures++;
+			return NULL;
+		}
+		LIST_INSERT_HEAD(&cache->partialSlabs, slab);
+	}
+
+	void **obj = slab->freeObjs;
+	slab->freeObjs = *obj;
+	slab->numOfInUseObjs++;
+	if (slab->numOfInUseObjs == cache->objsPerSlab)
+	{
+		LIST_REMOVE(&cache->partialSlabs, slab);
+		LIST_INSERT_HEAD(&cache->fullSlabs, slab);
+	}
+
+	cache->numOfActiveObjs++;
+	cache->numOfAllocs++;
+	if (cache->ctor != NULL)
+		cache->ctor(obj);
+	return obj;
+}
+
+void kmem_cache_free(struct Kmem_Cache *cache, void *obj)
+{
+	if (obj == NULL)
+		return;
+	struct Kmem_Slab *slab = (struct Kmem_Slab *)ROUNDDOWN((uint32)obj, PAGE_SIZE);
+	if (slab->cache != cache)
+		panic("kmem_cache_free: object %x does not belong to cache \"%s\"", obj, cache->name);
+
+	if (slab->numOfInUseObjs == cache->objsPerSlab)
+	{
+		LIST_REMOVE(&cache->fullSlabs, slab);
+		LIST_INSERT_HEAD(&cache->partialSlabs, slab);
+	}
+	*(void **)obj = slab->freeObjs;
+	slab->freeObjs = obj;
+	slab->numOfInUseObjs--;
+	if (slab->numOfInUseObjs == 0)
+	{
+		LIST_REMOVE(&cache->partialSlabs, slab);
+		if (LIST_SIZE(&cache->emptySlabs) < KMEM_MAX_EMPTY_SLABS)
+			LIST_INSERT_HEAD(&cache->emptySlabs, slab);
+		else
+			kfree(slab);
+	}
+
+	cache->numOfActiveObjs--;
+	cache->numOfFrees++;
+}
+
+// Return the cache that owns the given object
+struct Kmem_Cache *kmem_cache_of(void *obj)
+{
+	struct Kmem_Slab *slab = (struct Kmem_Slab *)ROUNDDOWN((uint32)obj, PAGE_SIZE);
+	return slab->cache;
+}
+
+void kmem_cache_print_statistics()
+{
+	cprintf("%-16s %8s %8s %8s %8s %10s %10s %8s\n", "cache", "objsize", "objs/slb", "slabs", "active", "allocs", "frees", "waste(B)");
+	for (int i = 0; i < KMEM_MAX_CACHES; i++)
+	{
+		struct Kmem_Cache *cache = &kmemCaches[i];
+		if (!cache->used)
+			continue;
+		uint32 numOfSlabs = LIST_SIZE(&cache->partialSlabs) + LIST_SIZE(&cache->fullSlabs) + LIST_SIZE(&cache->emptySlabs);
+		uint32 wasted = numOfSlabs * PAGE_SIZE - cache->numOfActiveObjs * cache->objSize;
+		cprintf("%-16s %8d %8d %8d %8d %10d %10d %8d\n", cache->name, cache->objSize, cache->objsPerSlab,
+				numOfSlabs, cache->numOfActiveObjs, cache->numOfAllocs, cache->numOfFrees, wasted);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef FOS_KERN_SLAB_H_
+#define FOS_KERN_SLAB_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/queue.h>
+
+// Object caches for small kernel objects (less than half a page).
+// Each slab is a single kernel heap page: a Kmem_Slab header followed by the objects.
+
+#define KMEM_MAX_CACHES 32
+#define KMEM_CACHE_NAME_LEN 32
+
+struct Kmem_Cache;
+
+struct Kmem_Slab
+{
+	LIST_ENTRY(Kmem_Slab) prev_next_info;
+	struct Kmem_Cache *cache;
+	uint32 numOfInUseObjs;
+	void *freeObjs; // free objects are linked through their first word
+};
+
+LIST_HEAD(Kmem_Slab_List, Kmem_Slab);
+
+struct Kmem_Cache
+{
+	char name[KMEM_CACHE_NAME_LEN];
+	uint32 objSize;
+	uint32 objsPerSlab;
+	void (*ctor)(void *obj); // called on every object returned by kmem_cache_alloc() (may be NULL)
+
+	struct Kmem_Slab_List partialSlabs;
+	struct Kmem_Slab_List fullSlabs;
+	struct Kmem_Slab_List emptySlabs;
+
+	// statistics
+	uint32 numOfActiveObjs;
+	uint32 numOfAllocs;
+	uint32 numOfFrees;
+	uint32 numOfFailures;
+
+	uint8 used;
+};
+
+// Largest object size that can be served from a slab (at least 2 objects per page)
+#define KMEM_MAX_OBJ_SIZE ((PAGE_SIZE - sizeof(struct Kmem_Slab)) / 2)
+
+struct Kmem_Cache *kmem_cache_create(char *name, uint32 objSize, void (*ctor)(void *obj));
+void *kmem_cache_alloc(struct Kmem_Cache *cache);
+void kmem_cache_free(struct Kmem_Cache *cache, void *obj);
+struct Kmem_Cache *kmem_cache_of(void *obj);
+void kmem_cache_print_statistics();
+
+#endif // FOS_KERN_SLAB_H_
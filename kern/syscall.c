@@ -310,7 +310,7 @@ void sys_enable_interrupt()
 
 void sys_clearFFL()
 {
-	int size = LIST_SIZE(&free_frame_list);
+	int size = calculate_free_frames();
 	int i = 0;
 	struct Frame_Info *ptr_tmp_FI;
 	for (; i < size; i++)
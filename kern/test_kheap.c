@@ -3,6 +3,8 @@
 #include <kern/memory_manager.h>
 #include <inc/queue.h>
 #include <kern/sched.h>
+#include <kern/buddy.h>
+#include <kern/slab.h>
 
 #define Mega (1024 * 1024)
 #define kilo (1024)
@@ -3225,41 +3227,47 @@ int test_krealloc()
 	{
 		int freeDiskFrames;
 		void *newAddress = NULL;
-		// Try to reallocate 2nd 1 MB with a size smaller than its current size (it should return the same VA and do nothing)
+		// Try to reallocate 2nd 1 MB with a size smaller than its current size (it should return the same VA and free its tail pages)
 		freeFrames = sys_calculate_free_frames();
 		newAddress = krealloc(ptr_allocations[1], 15 * kilo);
 		if ((uint32)newAddress < (KERNEL_HEAP_START))
 			panic("krealloc: Wrong start address for the allocated space... ");
 		if (newAddress != ptr_allocations[1])
 			panic(
-				"krealloc: Wrong allocation: krealloc reallocated an address with the same size (it should return same VA)");
-		if (freeFrames != sys_calculate_free_frames())
+				"krealloc: Wrong allocation: krealloc reallocated an address with a smaller size (it should return same VA)");
+		if (sys_calculate_free_frames() - freeFrames != 252)
 			panic(
-				"krealloc: Wrong number of frames after krealloc with the same size");
+				"krealloc: Wrong number of frames after krealloc with a smaller size (tail pages should be freed)");
 
-		// Try to reallocate 1st 2 MB with a size smaller than its current size (it should return the same VA and do nothing)
+		// Try to reallocate 1st 2 MB with a size smaller than its current size (it should return the same VA and free its tail pages)
 		freeFrames = sys_calculate_free_frames();
 		newAddress = krealloc(ptr_allocations[4], 1 * Mega - kilo);
 		if ((uint32)newAddress < (KERNEL_HEAP_START))
 			panic("krealloc: Wrong start address for the allocated space... ");
 		if (newAddress != ptr_allocations[4])
 			panic(
-				"krealloc: Wrong allocation: krealloc reallocated an address with the same size (it should return same VA)");
-		if (freeFrames != sys_calculate_free_frames())
+				"krealloc: Wrong allocation: krealloc reallocated an address with a smaller size (it should return same VA)");
+		if (sys_calculate_free_frames() - freeFrames != 256)
 			panic(
-				"krealloc: Wrong number of frames after krealloc with the same size");
+				"krealloc: Wrong number of frames after krealloc with a smaller size (tail pages should be freed)");
 
-		// Try to reallocate 2nd 1 MB with the same size it should return the same VA
+		// Reallocate 2nd 1 MB back to 1 MB: its freed tail is still free, so it should grow in place
 		freeFrames = sys_calculate_free_frames();
 		newAddress = krealloc(ptr_allocations[1], 1 * Mega - kilo);
 		if ((uint32)newAddress < (KERNEL_HEAP_START))
 			panic("krealloc: Wrong start address for the allocated space... ");
 		if (newAddress != ptr_allocations[1])
 			panic(
-				"krealloc: Wrong allocation: krealloc reallocated an address with the same size (it should return same VA)");
-		if (freeFrames != sys_calculate_free_frames())
+				"krealloc: Wrong allocation: krealloc reallocated a new address while there is a sufficient space after it (it should return same VA)");
+		if (freeFrames - sys_calculate_free_frames() != 252)
 			panic(
-				"krealloc: Wrong number of frames after krealloc with the same size");
+				"krealloc: Wrong number of frames after growing in place");
+		// rewrite the content of the re-grown pages
+		ptr = (char *)ptr_allocations[1];
+		for (int i = 0; i <= lastIndices[1]; ++i)
+		{
+			ptr[i] = 2;
+		}
 
 		// Try to reallocate 4th 1 MB with the same size it should return the same VA
 		freeFrames = sys_calculate_free_frames();
@@ -3287,7 +3295,7 @@ int test_krealloc()
 		if (freeFrames - sys_calculate_free_frames() != 2)
 			panic("krealloc: pages in memory are not loaded correctly");
 
-		// Reallocate 1st 2 MB to 2 MB + 2 MB
+		// Reallocate 1st 2 MB (already shrunk to 1 MB) to 1 MB + 3 MB
 		freeFrames = sys_calculate_free_frames();
 		newAddress = krealloc(ptr_allocations[4], (4 * Mega - kilo));
 		if ((uint32)newAddress < (KERNEL_HEAP_START))
@@ -3295,9 +3303,15 @@ int test_krealloc()
 		if (newAddress != ptr_allocations[4])
 			panic(
 				"Wrong allocation: krealloc reallocated a new address while there is a sufficient space after it (it should return same VA)");
-		// 2 MB only for the new size
-		if (freeFrames - sys_calculate_free_frames() != 512)
+		// 3 MB only for the new size
+		if (freeFrames - sys_calculate_free_frames() != 768)
 			panic("krealloc: pages in memory are not loaded correctly");
+		// rewrite the content of the re-grown pages
+		shortArr = (short *)ptr_allocations[4];
+		for (int i = 0; i <= lastIndices[4]; ++i)
+		{
+			shortArr[i] = 5;
+		}
 	}
 	cprintf("\b\b\b60%");
 	// Test krealloc: Cut & paste
@@ -3432,3 +3446,254 @@ int test_krealloc()
 	cprintf("\nCongratulations!! test krealloc completed successfully.\n");
 	return 0;
 }
+
+// Check the block chosen by each placement strategy of the free-extent index of the kernel heap: holes of 5, 3 and
+// 7 pages are made [separated by allocated pages] before the free tail of the heap, then each strategy is asked for
+// blocks that fit in several of them
+int test_kheap_placement()
+{
+	cprintf("==============================================\n");
+	cprintf("MAKE SURE to have a FRESH RUN for this test\n(i.e. don't run any program/test before it)\n");
+	cprintf("==============================================\n");
+
+	uint32 oldStrategy = _KHeapPlacementStrategy;
+
+	//[1] Make the holes: CONTALLOC places the blocks one after the other
+	setKHeapPlacementStrategyCONTALLOC();
+	char *h1 = kmalloc(5 * PAGE_SIZE);
+	char *s1 = kmalloc(PAGE_SIZE);
+	char *h2 = kmalloc(3 * PAGE_SIZE);
+	char *s2 = kmalloc(PAGE_SIZE);
+	char *h3 = kmalloc(7 * PAGE_SIZE);
+	char *s3 = kmalloc(PAGE_SIZE);
+	if (h1 == NULL || s1 != h1 + 5 * PAGE_SIZE || h2 != s1 + PAGE_SIZE || s2 != h2 + 3 * PAGE_SIZE ||
+		h3 != s2 + PAGE_SIZE || s3 != h3 + 7 * PAGE_SIZE)
+		panic("Wrong allocation, Check CONTALLOC strategy is working correctly");
+	kfree(h1);
+	kfree(h2);
+	kfree(h3);
+
+	char *ptr;
+	//[2] FIRST FIT: the lowest hole that fits
+	setKHeapPlacementStrategyFIRSTFIT();
+	if ((ptr = kmalloc(3 * PAGE_SIZE)) != h1)
+		panic("Wrong allocation, Check first fitting strategy is working correctly");
+	kfree(ptr);
+	if ((ptr = kmalloc(6 * PAGE_SIZE)) != h3)
+		panic("Wrong allocation, Check first fitting strategy is working correctly");
+	kfree(ptr);
+
+	//[3] BEST FIT: the smallest hole that fits
+	setKHeapPlacementStrategyBESTFIT();
+	if ((ptr = kmalloc(3 * PAGE_SIZE)) != h2)
+		panic("Wrong allocation, Check best fitting strategy is working correctly");
+	kfree(ptr);
+	if ((ptr = kmalloc(4 * PAGE_SIZE)) != h1)
+		panic("Wrong allocation, Check best fitting strategy is working correctly");
+	kfree(ptr);
+	if ((ptr = kmalloc(6 * PAGE_SIZE)) != h3)
+		panic("Wrong allocation, Check best fitting strategy is working correctly");
+	kfree(ptr);
+
+	//[4] WORST FIT: the largest free extent [the tail of the heap]
+	setKHeapPlacementStrategyWORSTFIT();
+	if ((ptr = kmalloc(3 * PAGE_SIZE)) != s3 + PAGE_SIZE)
+		panic("Wrong allocation, Check worst fitting strategy is working correctly");
+	kfree(ptr);
+
+	//[5] NEXT FIT: continue after the last allocated block
+	setKHeapPlacementStrategyFIRSTFIT();
+	char *a = kmalloc(2 * PAGE_SIZE);
+	setKHeapPlacementStrategyNEXTFIT();
+	char *b = kmalloc(3 * PAGE_SIZE);
+	char *c = kmalloc(3 * PAGE_SIZE);
+	char *d = kmalloc(5 * PAGE_SIZE);
+	char *e = kmalloc(PAGE_SIZE);
+	if (a != h1 || b != h1 + 2 * PAGE_SIZE || c != h2 || d != h3 || e != h3 + 5 * PAGE_SIZE)
+		panic("Wrong allocation, Check next fitting strategy is working correctly");
+	kfree(a);
+	kfree(b);
+	kfree(c);
+	kfree(d);
+	kfree(e);
+
+	//[6] Coalescing: freeing s1 merges it with the holes on both sides of it
+	setKHeapPlacementStrategyFIRSTFIT();
+	kfree(s1);
+	if ((ptr = kmalloc(9 * PAGE_SIZE)) != h1)
+		panic("Wrong kfree, Check the freed block is merged with its free neighbours");
+	kfree(ptr);
+
+	kfree(s2);
+	kfree(s3);
+	_KHeapPlacementStrategy = oldStrategy;
+
+	cprintf("\nCongratulations!! test kheap placement completed successfully.\n");
+	return 0;
+}
+
+static uint32 tstSlabNumOfCtorCalls;
+static void test_kmem_cache_ctor(void *obj)
+{
+	tstSlabNumOfCtorCalls++;
+}
+
+// Check the moves of the slabs of an object cache between its full/partial/empty lists, and that at most one
+// empty slab is kept by the cache [the other ones are given back to the kernel heap]
+int test_kmem_cache()
+{
+	struct Kmem_Cache *cache = kmem_cache_create("tst-slab", 1000, test_kmem_cache_ctor);
+	if (cache == NULL)
+		panic("kmem_cache_create: can't create the test cache");
+	if (cache->objSize != 1000 || cache->objsPerSlab != (PAGE_SIZE - ROUNDUP(sizeof(struct Kmem_Slab), sizeof(uint32))) / 1000)
+		panic("kmem_cache_create: wrong object size or number of objects per slab");
+	if (kmem_cache_create("tst-slab", 1000, test_kmem_cache_ctor) != cache)
+		panic("kmem_cache_create: a cache with the same name and size should be returned again");
+	if (cache->numOfActiveObjs != 0 || !LIST_EMPTY(&cache->partialSlabs) || !LIST_EMPTY(&cache->fullSlabs) || LIST_SIZE(&cache->emptySlabs) > 1)
+		panic("test cache is not empty. (objects of an earlier run are still allocated)");
+
+	uint32 n = cache->objsPerSlab;
+	uint8 *objs[8];
+	assert(n + 1 <= 8);
+	tstSlabNumOfCtorCalls = 0;
+
+	//[1] Fill one slab: it moves to the full list
+	for (int i = 0; i < n; i++)
+	{
+		objs[i] = kmem_cache_alloc(cache);
+		if (objs[i] == NULL)
+			panic("kmem_cache_alloc: failed to allocate an object");
+		if (ROUNDDOWN((uint32)objs[i], PAGE_SIZE) != ROUNDDOWN((uint32)objs[0], PAGE_SIZE))
+			panic("kmem_cache_alloc: the objects of a slab should be in the same page");
+		if (kmem_cache_of(objs[i]) != cache)
+			panic("kmem_cache_of: wrong cache of an object");
+		memset(objs[i], i + 1, cache->objSize);
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int k = 0; k < cache->objSize; k++)
+			if (objs[i][k] != i + 1)
+				panic("kmem_cache_alloc: objects overlap");
+	}
+	if (tstSlabNumOfCtorCalls != n)
+		panic("kmem_cache_alloc: the constructor should be called for each allocated object");
+	if (LIST_SIZE(&cache->fullSlabs) != 1 || !LIST_EMPTY(&cache->partialSlabs) || !LIST_EMPTY(&cache->emptySlabs))
+		panic("kmem_cache_alloc: a slab with all its objects allocated should be in the full list only");
+
+	//[2] One more object: a new slab in the partial list
+	objs[n] = kmem_cache_alloc(cache);
+	if (ROUNDDOWN((uint32)objs[n], PAGE_SIZE) == ROUNDDOWN((uint32)objs[0], PAGE_SIZE))
+		panic("kmem_cache_alloc: an object is allocated from a full slab");
+	if (LIST_SIZE(&cache->fullSlabs) != 1 || LIST_SIZE(&cache->partialSlabs) != 1)
+		panic("kmem_cache_alloc: a new slab should be created in the partial list");
+
+	//[3] Free an object of the full slab: full -> partial
+	kmem_cache_free(cache, objs[0]);
+	if (!LIST_EMPTY(&cache->fullSlabs) || LIST_SIZE(&cache->partialSlabs) != 2)
+		panic("kmem_cache_free: a full slab should move to the partial list when one of its objects is freed");
+
+	//[4] Free the only object of the second slab: partial -> empty [kept]
+	kmem_cache_free(cache, objs[n]);
+	if (LIST_SIZE(&cache->partialSlabs) != 1 || LIST_SIZE(&cache->emptySlabs) != 1)
+		panic("kmem_cache_free: a slab with no allocated objects should move to the empty list");
+
+	//[5] Empty the first slab: there's already an empty slab, so its page is given back
+	int freeFrames = sys_calculate_free_frames();
+	for (int i = 1; i < n; i++)
+		kmem_cache_free(cache, objs[i]);
+	if (!LIST_EMPTY(&cache->partialSlabs) || LIST_SIZE(&cache->emptySlabs) != 1)
+		panic("kmem_cache_free: only one empty slab should be kept per cache");
+	if (sys_calculate_free_frames() - freeFrames != 1)
+		panic("kmem_cache_free: the page of an extra empty slab should be freed");
+
+	//[6] The kept empty slab is reused without allocating a page
+	freeFrames = sys_calculate_free_frames();
+	uint8 *obj = kmem_cache_alloc(cache);
+	if (ROUNDDOWN((uint32)obj, PAGE_SIZE) != ROUNDDOWN((uint32)objs[n], PAGE_SIZE) || freeFrames != sys_calculate_free_frames())
+		panic("kmem_cache_alloc: the empty slab should be reused");
+	kmem_cache_free(cache, obj);
+	if (cache->numOfActiveObjs != 0 || LIST_SIZE(&cache->emptySlabs) != 1)
+		panic("kmem_cache_free: wrong number of active objects or empty slabs");
+
+	cprintf("\nCongratulations!! test kmem_cache completed successfully.\n");
+	return 0;
+}
+
+extern uint32 buddyNumOfSplits;
+extern uint32 buddyNumOfMerges;
+
+// Check the contiguous allocation of the buddy allocator, and the split/coalescing of a block it owns: the free
+// blocks of orders 0 and 1 are taken out first so that a request of order 0 has to split the test block
+int test_buddy()
+{
+	uint32 freeFrames = buddy_num_of_free_frames();
+
+	//[1] Contiguous allocation: 16 frames aligned on 16 frames
+	struct Frame_Info *ptr_block;
+	if (allocate_contiguous_frames(4, &ptr_block) != 0)
+		panic("allocate_contiguous_frames: failed to allocate 16 contiguous frames");
+	if ((to_frame_number(ptr_block) & 15) != 0)
+		panic("allocate_contiguous_frames: a block of order 4 should start at a multiple of 16 frames");
+	if (freeFrames - buddy_num_of_free_frames() != 16)
+		panic("allocate_contiguous_frames: wrong number of allocated frames");
+	for (int i = 0; i < 16; i++)
+	{
+		if (ptr_block[i].isBuddyFree || ptr_block[i].references != 0)
+			panic("allocate_contiguous_frames: the frames of the block should be allocated and not referenced");
+	}
+	free_contiguous_frames(ptr_block, 4);
+	if (buddy_num_of_free_frames() != freeFrames)
+		panic("free_contiguous_frames: wrong number of freed frames");
+
+	//[2] Take the free blocks of orders 0 and 1 out, and a block B of order 3
+	struct Linked_List takenBlocks[2];
+	for (int order = 0; order <= 1; order++)
+	{
+		LIST_INIT(&takenBlocks[order]);
+		while (!LIST_EMPTY(&buddy_free_lists[order]))
+			LIST_INSERT_HEAD(&takenBlocks[order], buddy_allocate_block(order));
+	}
+	struct Frame_Info *B = buddy_allocate_block(3);
+	if (B == NULL)
+		panic("buddy_allocate_block: failed to allocate a block of order 3");
+
+	//[3] Free the upper half of B: its buddy [the lower half] isn't free, so it stays a block of order 2
+	uint32 merges = buddyNumOfMerges;
+	buddy_free_block(B + 4, 2);
+	if (!B[4].isBuddyFree || B[4].buddyOrder != 2 || buddyNumOfMerges != merges)
+		panic("buddy_free_block: a block whose buddy isn't free shouldn't be merged");
+
+	//[4] Split: a request of order 0 takes the smallest free block [B + 4] and splits it twice
+	uint32 splits = buddyNumOfSplits;
+	struct Frame_Info *ptr_frame = buddy_allocate_block(0);
+	if (ptr_frame != B + 4 || buddyNumOfSplits - splits != 2)
+		panic("buddy_allocate_block: the smallest free block should be split to the requested order");
+	if (!B[5].isBuddyFree || B[5].buddyOrder != 0 || !B[6].isBuddyFree || B[6].buddyOrder != 1)
+		panic("buddy_allocate_block: the upper halves of a split block should go back to the free lists");
+
+	//[5] Coalesce: freeing the frame merges it with its free buddies up to B + 4 [order 2]...
+	buddy_free_block(ptr_frame, 0);
+	if (!B[4].isBuddyFree || B[4].buddyOrder != 2 || B[5].isBuddyFree || B[6].isBuddyFree || buddyNumOfMerges - merges != 2)
+		panic("buddy_free_block: a freed block should be merged with its free buddies");
+
+	//[6] ...and freeing the lower half of B merges the two halves
+	buddy_free_block(B, 2);
+	if (B[4].isBuddyFree || buddyNumOfMerges - merges < 3)
+		panic("buddy_free_block: the two halves of a block should be merged");
+
+	// give the taken blocks back
+	for (int order = 0; order <= 1; order++)
+	{
+		struct Frame_Info *ptr_fi;
+		LIST_FOREACH(ptr_fi, &takenBlocks[order])
+		{
+			LIST_REMOVE(&takenBlocks[order], ptr_fi);
+			buddy_free_block(ptr_fi, order);
+		}
+	}
+	if (buddy_num_of_free_frames() != freeFrames)
+		panic("buddy allocator: wrong number of free frames at the end of the test");
+
+	cprintf("\nCongratulations!! test buddy allocator completed successfully.\n");
+	return 0;
+}
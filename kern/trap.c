@@ -11,6 +11,10 @@
 #include <kern/syscall.h>
 #include <kern/sched.h>
 #include <kern/kclock.h>
+#include <kern/page_replacement.h>
+#include <kern/readahead.h>
+#include <kern/writeback.h>
+#include <kern/disk_queue.h>
 #include <kern/trap.h>
 
 extern void __static_cpt(uint32 *ptr_page_directory, const uint32 virtual_address, uint32 **ptr_page_table);
@@ -21,6 +25,9 @@ void table_fault_handler(struct Env *curenv, uint32 fault_va);
 
 static struct Taskstate ts;
 
+// Set by fault_handler(): the faulted page can be read by the disk interrupt while the faulting env is blocked
+static uint8 pageFaultCanBlock;
+
 // 2014 Test Free(): Set it to bypass the PAGE FAULT on an instruction with this length and continue executing the next one
 //  0 means don't bypass the PAGE FAULT
 uint8 bypassInstrLength = 0;
@@ -226,6 +233,10 @@ static void trap_dispatch(struct Trapframe *tf)
 	{
 		clock_interrupt_handler();
 	}
+	else if (tf->tf_trapno == IRQ14_Disk)
+	{
+		disk_queue_interrupt();
+	}
 
 	else
 	{
@@ -294,6 +305,7 @@ void setPageReplacmentAlgorithmLRU() { _PageRepAlgoType = PG_REP_LRU; }
 void setPageReplacmentAlgorithmCLOCK() { _PageRepAlgoType = PG_REP_CLOCK; }
 void setPageReplacmentAlgorithmFIFO() { _PageRepAlgoType = PG_REP_FIFO; }
 void setPageReplacmentAlgorithmModifiedCLOCK() { _PageRepAlgoType = PG_REP_MODIFIEDCLOCK; }
+void setPageReplacmentAlgorithmARC() { _PageRepAlgoType = PG_REP_ARC; }
 
 uint32 isPageReplacmentAlgorithmLRU()
 {
@@ -319,6 +331,18 @@ uint32 isPageReplacmentAlgorithmModifiedCLOCK()
 		return 1;
 	return 0;
 }
+uint32 isPageReplacmentAlgorithmARC()
+{
+	if (_PageRepAlgoType == PG_REP_ARC)
+		return 1;
+	return 0;
+}
+
+void setPageReplacmentGlobal(uint32 global) { _PageRepGlobal = global; }
+uint32 isPageReplacmentGlobal() { return _PageRepGlobal; }
+
+void setFaultAroundWindow(uint32 numOfPages) { _FaultAroundWindow = MIN(numOfPages, FAULT_AROUND_MAX_WINDOW); }
+uint32 getFaultAroundWindow() { return _FaultAroundWindow; }
 
 void enableModifiedBuffer(uint32 enableIt) { _EnableModifiedBuffer = enableIt; }
 uint32 isModifiedBufferEnabled() { return _EnableModifiedBuffer; }
@@ -388,6 +412,7 @@ void fault_handler(struct Trapframe *tf)
 
 	// get a pointer to the environment that caused the fault at runtime
 	struct Env *faulted_env = curenv;
+	pageFaultCanBlock = userTrap && isDiskAsyncReadsEnabled();
 
 	// check the faulted address, is it a table or not ?
 	// If the directory entry of the faulted address is NOT PRESENT then
@@ -424,6 +449,15 @@ void fault_handler(struct Trapframe *tf)
 	// Refresh the TLB cache
 	tlbflush();
 	/*************************************************************/
+
+	// The page is being read by the disk interrupt: run another env meanwhile. The faulting env is
+	// made READY when the read is done and re-executes the faulting instruction [see kern/disk_queue.c]
+	if (userTrap && disk_queue_has_request(curenv))
+	{
+		curenv->env_status = ENV_BLOCKED;
+		curenv = NULL;
+		fos_scheduler();
+	}
 }
 
 // Handle the table fault
@@ -448,6 +482,125 @@ void page_fault_handler(struct Env *curenv, uint32 fault_va)
 	//[PRO'23] DON'T CHANGE THIS FUNCTION;
 	__page_fault_handler_with_buffering(curenv, fault_va);
 }
+// Remove the page of the given WS entry from the WS of e: its frame is buffered in the modified list (if the page
+// is modified) or in the free list, so a later fault on the page reclaims it without reading the page file
+void page_ws_evict_entry(struct Env *e, uint32 entry_index)
+{
+	uint32 *ptr_table = NULL;
+	uint32 VictimVA = env_page_ws_get_virtual_address(e, entry_index);
+	uint32 Victim_Perm = pt_get_page_permissions(e, VictimVA);
+
+	env_page_ws_clear_entry(e, entry_index);
+	struct Frame_Info *ptr_victim_frame = get_frame_info(e->env_page_directory, (void *)VictimVA, &ptr_table);
+	pt_set_page_permissions(e, VictimVA, PERM_BUFFERED, PERM_PRESENT); // Set the BUFFERED bit to 1 & the PRESENT bit to 0 in the victim page table.
+	ptr_victim_frame->isBuffered = 1;	   // Flagging it as buffered.
+	ptr_victim_frame->environment = e;	   // Setting the environment inside it.
+	ptr_victim_frame->va = VictimVA;	   // Setting the victim virtual address inside it.
+
+	if (Victim_Perm & PERM_MODIFIED)
+	{
+		bufferList_add_page(&modified_frame_list, ptr_victim_frame);
+		uint32 size = LIST_SIZE(&modified_frame_list);
+		if (size == getModifiedBufferLength())
+		{
+			writeback_modified_frames(0, 0);
+		}
+	}
+	else
+	{
+		bufferList_add_page(&free_frame_list, ptr_victim_frame);
+	}
+}
+
+// Put the given page in the WS entry at page_last_WS_index if it's empty, or in the lowest empty entry
+static uint32 page_ws_place(struct Env *curenv, uint32 va)
+{
+	uint32 entry_index = curenv->page_last_WS_index;
+	if (!curenv->ptr_pageWorkingSet[entry_index].empty)
+	{
+		// take the lowest empty entry from the WS index instead of scanning the WS
+		entry_index = env_page_ws_find_empty_entry(curenv);
+	}
+	env_page_ws_set_entry(curenv, entry_index, va);
+	curenv->page_last_WS_index++;
+	if (curenv->page_WS_max_size == curenv->page_last_WS_index)
+	{
+		curenv->page_last_WS_index = 0; // if the index reaches the last of the wroking set
+	}
+	return entry_index;
+}
+
+// Map new frames for the pages that can be read with the faulted one from the page file, every stride pages
+// after fault_va [fault-around & readahead]. They should be in the page file and not in memory (neither present
+// nor buffered), under a page table in memory, and fit in the empty WS entries with the faulted page.
+// Return their number
+static uint32 prefetch_map_pages(struct Env *curenv, uint32 fault_va, int32 stride, uint32 window)
+{
+	fault_va = ROUNDDOWN(fault_va, PAGE_SIZE);
+	window = MIN(window, env_page_ws_get_quota(curenv) - env_page_ws_get_size(curenv) - 1);
+	if (window == 0 || pf_count_env_pages(curenv, fault_va, 1) == 0)
+		return 0;
+
+	uint32 n = 0;
+	for (; n < window; n++)
+	{
+		uint32 va = fault_va + (n + 1) * stride * PAGE_SIZE;
+		if (va >= USER_TOP || !(curenv->env_page_directory[PDX(va)] & PERM_PRESENT) ||
+			(pt_get_page_permissions(curenv, va) & (PERM_PRESENT | PERM_BUFFERED)) || pf_count_env_pages(curenv, va, 1) == 0)
+			break;
+	}
+	if (n == 0)
+		return 0;
+
+	struct Linked_List frames;
+	LIST_INIT(&frames);
+	if (allocate_frames(n, &frames) == E_NO_MEM)
+		return 0;
+	for (uint32 k = 1; k <= n; k++)
+	{
+		struct Frame_Info *ptr_frame_info = LIST_FIRST(&frames);
+		LIST_REMOVE(&frames, ptr_frame_info);
+		map_frame(curenv->env_page_directory, ptr_frame_info, (void *)(fault_va + k * stride * PAGE_SIZE), PERM_USER | PERM_WRITEABLE);
+	}
+	return n;
+}
+
+// Return 1 if the faulted page is only reserved in the page file [lazy page-file allocation]: it's zero-filled
+// instead of read
+static uint8 page_fault_is_zero_filled(struct Env *curenv, uint32 fault_va)
+{
+	if (!pf_is_env_page_reserved(curenv, fault_va))
+		return 0;
+	diskAllocStats.numOfZeroFilledPages++;
+	return 1;
+}
+
+// Read the faulted page from the page file into its frame [mapped at fault_va]
+static int page_fault_read_page(struct Env *curenv, uint32 fault_va)
+{
+	if (pageFaultCanBlock)
+		return pf_read_env_page_async(curenv, (void *)fault_va);
+	return pf_read_env_page(curenv, (void *)fault_va);
+}
+
+// Read the faulted page and the numOfPages pages mapped by prefetch_map_pages() from the page file:
+// adjacent pages are read by one disk command
+static int prefetch_read_pages(struct Env *curenv, uint32 fault_va, int32 stride, uint32 numOfPages)
+{
+	fault_va = ROUNDDOWN(fault_va, PAGE_SIZE);
+	if (numOfPages == 0)
+		return page_fault_read_page(curenv, fault_va);
+	if (stride == 1)
+		return pf_read_env_pages(curenv, (void *)fault_va, 1 + numOfPages);
+	if (stride == -1)
+		return pf_read_env_pages(curenv, (void *)(fault_va - numOfPages * PAGE_SIZE), 1 + numOfPages);
+
+	int ret = pf_read_env_page(curenv, (void *)fault_va);
+	for (uint32 k = 1; k <= numOfPages && ret == 0; k++)
+		ret = pf_read_env_page(curenv, (void *)(fault_va + k * stride * PAGE_SIZE));
+	return ret;
+}
+
 void __page_fault_handler_with_buffering(struct Env *curenv, uint32 fault_va)
 {
 	// TODO: [PROJECT 2023 - MS2 - [3] Page Fault Handler: PLACEMENT & REPLACEMENT CASES]
@@ -456,13 +609,20 @@ void __page_fault_handler_with_buffering(struct Env *curenv, uint32 fault_va)
 	uint32 page_permissions = pt_get_page_permissions(curenv, fault_va);
 	struct Frame_Info *ptr_frame_info = get_frame_info(curenv->env_page_directory, (void *)fault_va, &ptr_table);
 
-	if (env_page_ws_get_size(curenv) < curenv->page_WS_max_size)
+	// Pages to read with the faulted one from the page file: the following ones [fault-around],
+	// or the next ones of its sequential/strided stream [readahead, when enabled]
+	int32 prefetchStride = 1;
+	uint32 prefetchWindow = getFaultAroundWindow();
+	uint32 numOfPrefetchedPages = 0;
+	if (getReadaheadMaxWindow() > 0)
+		prefetchWindow = readahead_on_fault(curenv, fault_va, &prefetchStride);
+
+	if (env_page_ws_get_size(curenv) < env_page_ws_get_quota(curenv))
 	{
 		// Placement
 		if (page_permissions & PERM_BUFFERED)
 		{
 			pt_set_page_permissions(curenv, fault_va, PERM_PRESENT, PERM_BUFFERED);
-			ptr_frame_info->isBuffered = 0;
 
 			if (page_permissions & PERM_MODIFIED)
 			{
@@ -472,13 +632,28 @@ void __page_fault_handler_with_buffering(struct Env *curenv, uint32 fault_va)
 			{
 				bufferlist_remove_page(&free_frame_list, ptr_frame_info);
 			}
+			// clear the flag after removing it from its list (the list counters depend on it)
+			ptr_frame_info->isBuffered = 0;
 		}
 		else
 		{
-			allocate_frame(&ptr_frame_info);
+			// a stack page that isn't in the page file yet or a page that's only reserved there [lazy page-file
+			// allocation] should be zeroed: take a pre-zeroed frame for them [a page read from the page file
+			// doesn't need one]
+			uint8 reserved = page_fault_is_zero_filled(curenv, fault_va);
+			if (reserved || (fault_va >= USTACKBOTTOM && fault_va < USTACKTOP && pf_count_env_pages(curenv, fault_va, 1) == 0))
+				allocate_zeroed_frame(&ptr_frame_info);
+			else
+				allocate_frame(&ptr_frame_info);
 			map_frame(curenv->env_page_directory, ptr_frame_info, (void *)fault_va, PERM_USER | PERM_WRITEABLE);
 
-			int ret = pf_read_env_page(curenv, (void *)fault_va);
+			// a reserved page has nothing to read
+			int ret = 0;
+			if (!reserved)
+			{
+				numOfPrefetchedPages = prefetch_map_pages(curenv, fault_va, prefetchStride, prefetchWindow);
+				ret = prefetch_read_pages(curenv, fault_va, prefetchStride, numOfPrefetchedPages);
+			}
 			if (ret == E_PAGE_NOT_EXIST_IN_PF)
 			{
 				// check if it is a stack page
@@ -497,144 +672,50 @@ void __page_fault_handler_with_buffering(struct Env *curenv, uint32 fault_va)
 			}
 		}
 		// update working set
-		uint32 entry_index = curenv->page_last_WS_index;
-		if(curenv->ptr_pageWorkingSet[entry_index].empty) 
+		page_ws_place(curenv, fault_va);
+
+		// the prefetched pages join the WS as pages that aren't used yet
+		for (uint32 k = 1; k <= numOfPrefetchedPages; k++)
 		{
-			env_page_ws_set_entry(curenv, entry_index, fault_va);
-			curenv->page_last_WS_index++;
-			if (curenv->page_WS_max_size == curenv->page_last_WS_index)
-			{
-				curenv->page_last_WS_index = 0; // if the index reaches the last of the wroking set
-			}
+			uint32 va = ROUNDDOWN(fault_va, PAGE_SIZE) + k * prefetchStride * PAGE_SIZE;
+			uint32 entry_index = page_ws_place(curenv, va);
+			curenv->ptr_pageWorkingSet[entry_index].time_stamp = 0;
+			pt_set_page_permissions(curenv, va, 0, PERM_USED);
 		}
-		else
-		{
-			for (int i = 0; i < curenv->page_WS_max_size; i++)
-			{
-				if (curenv->ptr_pageWorkingSet[i].empty)
-				{
-					env_page_ws_set_entry(curenv, i, fault_va);
-					curenv->page_last_WS_index++;
-					if (curenv->page_WS_max_size == curenv->page_last_WS_index)
-					{
-						curenv->page_last_WS_index = 0; // if the index reaches the last of the wroking set
-					}
-					break;
-				}
-			}
-		}	
+		if (getReadaheadMaxWindow() == 0)
+			faultAroundNumOfPages += numOfPrefetchedPages;
 	}
 	// Replacement
 	else
 	{
-		uint32 VictimVA;
-		uint32 Victim_Perm;
-		int Victim_Index;
-		bool flag = 0;
-		while (flag == 0)
-		{
-			// Try 1
-			for (int i = curenv->page_last_WS_index; i < env_page_ws_get_size(curenv); i++) // start from the curenv->page_last_WS_index;
-			{
-				Victim_Perm = pt_get_page_permissions(curenv, curenv->ptr_pageWorkingSet[i].virtual_address);
-				if (!(Victim_Perm & PERM_USED) && !(Victim_Perm & PERM_MODIFIED))
-				{
-					VictimVA = curenv->ptr_pageWorkingSet[i].virtual_address;
-					Victim_Index = i;
-					flag = 1;
-					break;
-				}
-			}
-			if (flag == 0)
-			{
-				for (int i = 0; i < curenv->page_last_WS_index; i++)
-				{
-					Victim_Perm = pt_get_page_permissions(curenv, curenv->ptr_pageWorkingSet[i].virtual_address);
-					if (!(Victim_Perm & PERM_USED) && !(Victim_Perm & PERM_MODIFIED))
-					{
-						VictimVA = curenv->ptr_pageWorkingSet[i].virtual_address;
-						Victim_Index = i;
-						flag = 1;
-						break;
-					}
-				}
-			}
-			// Try 2
-			if (flag == 0)
-			{
-				for (int i = curenv->page_last_WS_index; i < env_page_ws_get_size(curenv); i++) // start from the curenv->page_last_WS_index;
-				{
-					Victim_Perm = pt_get_page_permissions(curenv, curenv->ptr_pageWorkingSet[i].virtual_address);
-					if (!(Victim_Perm & PERM_USED))
-					{
-						VictimVA = curenv->ptr_pageWorkingSet[i].virtual_address;
-						Victim_Index = i;
-						flag = 1;
-						break;
-					}
-					else
-					{
-						pt_set_page_permissions(curenv, curenv->ptr_pageWorkingSet[i].virtual_address, 0, PERM_USED);
-					}
-				}
-			}
-			if (flag == 0)
-			{
-				for (int i = 0; i < curenv->page_last_WS_index; i++)
-				{
-					Victim_Perm = pt_get_page_permissions(curenv, curenv->ptr_pageWorkingSet[i].virtual_address);
-					if (!(Victim_Perm & PERM_USED))
-					{
-						VictimVA = curenv->ptr_pageWorkingSet[i].virtual_address;
-						Victim_Index = i;
-						flag = 1;
-						break;
-					}
-					else
-					{
-						pt_set_page_permissions(curenv, curenv->ptr_pageWorkingSet[i].virtual_address, 0, PERM_USED);
-					}
-				}
-			}
-		}
-		env_page_ws_clear_entry(curenv, Victim_Index);
-		env_page_ws_set_entry(curenv, Victim_Index, fault_va);
-		struct Frame_Info *ptr_victim_frame = get_frame_info(curenv->env_page_directory, (void *)VictimVA, &ptr_table);
-		pt_set_page_permissions(curenv, VictimVA, PERM_BUFFERED, PERM_PRESENT);     // Set the BUFFERED bit to 1 & the PRESENT bit to 0 in the victim page table.
-		ptr_victim_frame->isBuffered = 1;            // Flagging it as buffered.
-		ptr_victim_frame->environment = curenv;     // Setting the environment inside it.
-		ptr_victim_frame->va = VictimVA;		    // Setting the victim virtual address inside it.
-
-		if (Victim_Perm & PERM_MODIFIED)
+		// Ask the current replacement algorithm for the victim [or the global clock]
+		uint32 Victim_Index;
+		struct Env *victimEnv = curenv;
+		if (isPageReplacmentGlobal())
+			victimEnv = select_global_victim(curenv, &Victim_Index);
+		else
+			Victim_Index = select_WS_victim(curenv);
+		if (victimEnv != curenv && env_page_ws_grow_quota(curenv) == 0)
 		{
-			bufferList_add_page(&modified_frame_list, ptr_victim_frame);
-			uint32 size = LIST_SIZE(&modified_frame_list);
-			if (size == getModifiedBufferLength())
-			{
-				struct Frame_Info *ptr_fi;
-				LIST_FOREACH(ptr_fi, &modified_frame_list)
-				{
-					int ret = pf_update_env_page(ptr_fi->environment, (void *)ptr_fi->va, ptr_fi);
-					if (ret == E_PAGE_NOT_EXIST_IN_PF)
-					{
-						panic("ERROR: Page doesnt exit in page file!");
-					}
-					pt_set_page_permissions(ptr_fi->environment, ptr_fi->va, 0, PERM_MODIFIED);
-					bufferlist_remove_page(&modified_frame_list, ptr_fi);
-					bufferList_add_page(&free_frame_list, ptr_fi);
-				}
-			}
+			// a page of another env: it gives its WS entry to the faulting env [the quotas move without
+			// reallocating the WS arrays at each fault]
+			page_ws_evict_entry(victimEnv, Victim_Index);
+			env_page_ws_shrink_quota(victimEnv);
+			Victim_Index = env_page_ws_find_empty_entry(curenv);
 		}
 		else
 		{
-			bufferList_add_page(&free_frame_list, ptr_victim_frame);
+			// the victim page is the faulting env's own [local replacement, or the global clock chose it], or
+			// there's no kernel heap space to grow its WS: replace one of its own pages
+			if (victimEnv != curenv)
+				Victim_Index = select_WS_victim(curenv);
+			page_ws_evict_entry(curenv, Victim_Index);
 		}
 
 		// Placement again
 		if (page_permissions & PERM_BUFFERED)
 		{
 			pt_set_page_permissions(curenv, fault_va, PERM_PRESENT, PERM_BUFFERED);
-			ptr_frame_info->isBuffered = 0;
 
 			if (page_permissions & PERM_MODIFIED)
 			{
@@ -644,13 +725,23 @@ void __page_fault_handler_with_buffering(struct Env *curenv, uint32 fault_va)
 			{
 				bufferlist_remove_page(&free_frame_list, ptr_frame_info);
 			}
+			// clear the flag after removing it from its list (the list counters depend on it)
+			ptr_frame_info->isBuffered = 0;
 		}
 		else
 		{
-			allocate_frame(&ptr_frame_info);
+			// a stack page that isn't in the page file yet or a page that's only reserved there [lazy page-file
+			// allocation] should be zeroed: take a pre-zeroed frame for them [a page read from the page file
+			// doesn't need one]
+			uint8 reserved = page_fault_is_zero_filled(curenv, fault_va);
+			if (reserved || (fault_va >= USTACKBOTTOM && fault_va < USTACKTOP && pf_count_env_pages(curenv, fault_va, 1) == 0))
+				allocate_zeroed_frame(&ptr_frame_info);
+			else
+				allocate_frame(&ptr_frame_info);
 			map_frame(curenv->env_page_directory, ptr_frame_info, (void*)fault_va, PERM_USER | PERM_WRITEABLE);
 
-			int ret = pf_read_env_page(curenv, (void *)fault_va);
+			// a reserved page has nothing to read
+			int ret = reserved ? 0 : page_fault_read_page(curenv, fault_va);
 			if (ret == E_PAGE_NOT_EXIST_IN_PF)
 			{
 				// check if it is a stack page
@@ -678,5 +769,7 @@ void __page_fault_handler_with_buffering(struct Env *curenv, uint32 fault_va)
 		}
 
 	}
+	if (getReadaheadMaxWindow() > 0)
+		readahead_done(curenv, numOfPrefetchedPages);
 	// refer to the project documentation for the detailed steps of the page fault handler
 } 
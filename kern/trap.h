@@ -8,6 +8,7 @@
 
 #include <inc/trap.h>
 #include <inc/mmu.h>
+#include <inc/memlayout.h>
 
 /* The kernel's interrupt descriptor table */
 extern struct Gatedesc idt[];
@@ -17,11 +18,21 @@ extern uint8 bypassInstrLength;
 uint32 _EnableModifiedBuffer;
 uint32 _EnableBuffering;
 
+// Fault-around: max number of pages read from the page file after the faulted one (0 = disabled)
+uint32 _FaultAroundWindow;
+uint32 faultAroundNumOfPages; // pages brought in by fault-around so far
+#define FAULT_AROUND_MAX_WINDOW (KERNEL_DISK_WINDOW_PAGES - 1) // the faulted page and its window are read by one batch
+
 uint32 _PageRepAlgoType;
 #define PG_REP_LRU 0x1
 #define PG_REP_CLOCK 0x2
 #define PG_REP_FIFO 0x3
 #define PG_REP_MODIFIEDCLOCK 0x4
+#define PG_REP_ARC 0x5
+
+// Replacement scope: the victim is taken from the WS of the faulting environment [local, default], or from the
+// WSs of all the environments in memory by the global clock [global]
+uint32 _PageRepGlobal;
 
 void idt_init(void);
 void print_regs(struct PushRegs *regs);
@@ -33,11 +44,21 @@ void setPageReplacmentAlgorithmLRU();
 void setPageReplacmentAlgorithmCLOCK();
 void setPageReplacmentAlgorithmFIFO();
 void setPageReplacmentAlgorithmModifiedCLOCK();
+void setPageReplacmentAlgorithmARC();
 
 uint32 isPageReplacmentAlgorithmLRU();
 uint32 isPageReplacmentAlgorithmCLOCK();
 uint32 isPageReplacmentAlgorithmFIFO();
 uint32 isPageReplacmentAlgorithmModifiedCLOCK();
+uint32 isPageReplacmentAlgorithmARC();
+
+void setPageReplacmentGlobal(uint32 global);
+uint32 isPageReplacmentGlobal();
+
+void page_ws_evict_entry(struct Env *e, uint32 entry_index);
+
+void setFaultAroundWindow(uint32 numOfPages);
+uint32 getFaultAroundWindow();
 
 void enableModifiedBuffer(uint32 enableIt);
 uint32 isModifiedBufferEnabled();
@@ -15,6 +15,8 @@
 #include <kern/helpers.h>
 #include <kern/sched.h>
 #include <kern/kheap.h>
+#include <kern/slab.h>
+#include <kern/page_replacement.h>
 #include <inc/queue.h>
 
 extern int pf_add_env_page(struct Env *ptr_env, uint32 virtual_address, void *ptrDataSrc);
@@ -102,6 +104,8 @@ DECLARE_START_OF(tst_buffer_1)
 DECLARE_START_OF(tst_buffer_2)
 DECLARE_START_OF(tst_buffer_2_slave)
 DECLARE_START_OF(tst_buffer_3)
+DECLARE_START_OF(tst_disk_async_master)
+DECLARE_START_OF(tst_disk_async_slave)
 DECLARE_START_OF(tst_quicksort_freeHeap)
 DECLARE_START_OF(concurrent_start)
 DECLARE_START_OF(tst_semaphore_1master);
@@ -373,6 +377,8 @@ struct UserProgramInfo userPrograms[] = {
 	{"tpb2", "tests freeing modified list when it reaches MAX size", PTR_START_OF(tst_buffer_2)},
 	{"tpb2slave", "Slave program for tbf2", PTR_START_OF(tst_buffer_2_slave)},
 	{"tpb3", "tests removing buffered pages during free", PTR_START_OF(tst_buffer_3)},
+	{"tdiskasync", "tests two programs faulting on page-file reads at the same time [run diskasync 1 first]", PTR_START_OF(tst_disk_async_master)},
+	{"tdiskasyncslave", "Slave program for tdiskasync", PTR_START_OF(tst_disk_async_slave)},
 
 	//		{ "tf1", "tests free (1): freeing tables, WS and page file [placement case]", PTR_START_OF(tst_free_1)},
 	//		{ "tf2", "tests free (2): try accessing values in freed spaces", PTR_START_OF(tst_free_2)},
@@ -478,6 +484,47 @@ void free_environment(struct Env *e)
 	LIST_INSERT_HEAD(&env_free_list, e);
 }
 
+// Return the object cache of the working set index objects of the given size (rounded up to a power of 2)
+static struct Kmem_Cache *get_user_page_WS_index_cache(uint32 nBytes)
+{
+	uint32 classSize = 64;
+	while (classSize < nBytes)
+		classSize <<= 1;
+	if (classSize > KMEM_MAX_OBJ_SIZE)
+		classSize = ROUNDDOWN(KMEM_MAX_OBJ_SIZE, sizeof(uint32));
+
+	char name[KMEM_CACHE_NAME_LEN];
+	snprintf(name, KMEM_CACHE_NAME_LEN, "WSI-%d", classSize);
+	return kmem_cache_create(name, classSize, NULL);
+}
+
+static void *allocate_user_page_WS_index(uint32 nBytes)
+{
+	// Small indices share slab pages instead of taking a whole kernel heap page each [they're never mapped at
+	// the user side, unlike the WS array itself]
+	if (nBytes <= KMEM_MAX_OBJ_SIZE)
+	{
+		struct Kmem_Cache *cache = get_user_page_WS_index_cache(nBytes);
+		if (cache != NULL)
+			return kmem_cache_alloc(cache);
+	}
+	return kmalloc(nBytes);
+}
+
+static void free_user_page_WS_index(uint32 nBytes, void *obj)
+{
+	if (nBytes <= KMEM_MAX_OBJ_SIZE)
+	{
+		struct Kmem_Cache *cache = get_user_page_WS_index_cache(nBytes);
+		if (cache != NULL)
+		{
+			kmem_cache_free(cache, obj);
+			return;
+		}
+	}
+	kfree(obj);
+}
+
 void *create_user_page_WS(unsigned int numOfElements)
 {
 	// Use kmalloc() to allocate a new space for a working set with numOfElements elements
@@ -485,6 +532,12 @@ void *create_user_page_WS(unsigned int numOfElements)
 	return kmalloc(nBytes);
 }
 
+// Allocate the (kernel only) index of a working set with numOfElements elements
+void *create_user_page_WS_index(unsigned int numOfElements)
+{
+	return allocate_user_page_WS_index(env_page_ws_index_size(numOfElements));
+}
+
 void *create_user_directory()
 {
 	// Use kmalloc() to allocate a new directory
@@ -496,14 +549,14 @@ void *create_user_directory()
 	return ptr_user_page_directory;
 }
 
-void ShareWSAtUserSpace(struct Env *e)
+// Map the page WS of e at USER_PAGES_WS_START so that the user side can read it
+static void map_user_page_WS(struct Env *e)
 {
 	e->__uptr_pws = (struct WorkingSetElement *)USER_PAGES_WS_START;
-	e->ptr_pageWorkingSet = create_user_page_WS(e->page_WS_max_size);
 	unsigned int sva = (unsigned int)e->ptr_pageWorkingSet;
 	uint32 nBytes = sizeof(struct WorkingSetElement) * e->page_WS_max_size;
-	unsigned int dva = (unsigned int)(e->__uptr_pws);
-	for (sva = (uint32)(e->ptr_pageWorkingSet); sva < ((uint32)(e->ptr_pageWorkingSet) + nBytes); sva += PAGE_SIZE, dva += PAGE_SIZE)
+	unsigned int dva = USER_PAGES_WS_START;
+	for (; sva < ((uint32)(e->ptr_pageWorkingSet) + nBytes); sva += PAGE_SIZE, dva += PAGE_SIZE)
 	{
 		// 2017: Copy the table entries instead of mapping (to avoid increasing the number of references of corresponding frames)
 		// unsigned int pa = kheap_physical_address(sva);
@@ -518,6 +571,122 @@ void ShareWSAtUserSpace(struct Env *e)
 	}
 }
 
+// Remove the user side mapping of the page WS of e [the table entries were copied, so just clear them]
+static void unmap_user_page_WS(struct Env *e)
+{
+	uint32 nBytes = sizeof(struct WorkingSetElement) * e->page_WS_max_size;
+	for (uint32 dva = (uint32)e->__uptr_pws; dva < (uint32)e->__uptr_pws + nBytes; dva += PAGE_SIZE)
+	{
+		uint32 *ptr_page_table;
+		if (get_page_table(e->env_page_directory, (void *)dva, &ptr_page_table) == TABLE_IN_MEMORY)
+			ptr_page_table[PTX(dva)] = 0;
+	}
+}
+
+void ShareWSAtUserSpace(struct Env *e)
+{
+	e->ptr_pageWorkingSet = create_user_page_WS(e->page_WS_max_size);
+	map_user_page_WS(e);
+}
+
+// Give e one more WS entry for a page it takes from another env [global replacement]: one of the spare entries of
+// its WS array, after growing the array by GLOBAL_REPLACEMENT_WS_GROW_STEP entries if there's none, so that it's
+// reallocated once for that many taken pages.
+// RETURNS: 0 on success, E_NO_MEM if there's no kernel heap space to grow the WS [its quota is left unchanged]
+int env_page_ws_grow_quota(struct Env *e)
+{
+	if (e->page_WS_num_of_spare_entries == 0)
+	{
+		if (env_page_ws_resize(e, e->page_WS_max_size + GLOBAL_REPLACEMENT_WS_GROW_STEP) != 0)
+			return E_NO_MEM;
+		e->page_WS_num_of_spare_entries = GLOBAL_REPLACEMENT_WS_GROW_STEP;
+	}
+	e->page_WS_num_of_spare_entries--;
+	return 0;
+}
+
+// Take one WS entry out of the quota of e [its page was just evicted and the entry is empty]: the array keeps its
+// size till env_page_ws_trim()
+void env_page_ws_shrink_quota(struct Env *e)
+{
+	assert(env_page_ws_get_size(e) < env_page_ws_get_quota(e));
+	e->page_WS_num_of_spare_entries++;
+}
+
+// Shrink the WS array of e to its quota once it has more than GLOBAL_REPLACEMENT_WS_GROW_STEP spare entries
+// [called at the clock tick]. Nothing is evicted: the WS holds at most its quota
+void env_page_ws_trim(struct Env *e)
+{
+	if (e == NULL || e->page_WS_num_of_spare_entries <= GLOBAL_REPLACEMENT_WS_GROW_STEP)
+		return;
+	env_page_ws_resize(e, env_page_ws_get_quota(e));
+}
+
+// Change the max size of the page WS of e to newSize [at least 1]: if it has more pages than that, the ones
+// not used since they were last checked are evicted first, then the oldest ones. The WS array and its index
+// are reallocated, the remaining pages keep their load order and time stamps, and the new array is mapped at
+// the user side instead of the old one.
+// RETURNS: 0 on success, E_NO_MEM if there's no kernel heap space for the new WS [it's left unchanged]
+int env_page_ws_resize(struct Env *e, uint32 newSize)
+{
+	assert(USE_KHEAP && newSize > 0);
+	uint32 oldSize = e->page_WS_max_size;
+	if (newSize == oldSize)
+		return 0;
+
+	struct WorkingSetElement *newWS = create_user_page_WS(newSize);
+	void *newIndex = create_user_page_WS_index(newSize);
+	if (newWS == NULL || newIndex == NULL)
+	{
+		if (newWS != NULL)
+			kfree(newWS);
+		if (newIndex != NULL)
+			free_user_page_WS_index(env_page_ws_index_size(newSize), newIndex);
+		return E_NO_MEM;
+	}
+
+	for (uint8 evictUsed = 0; evictUsed <= 1 && env_page_ws_get_size(e) > newSize; evictUsed++)
+	{
+		int32 i = env_page_ws_get_oldest_entry(e);
+		while (i != -1 && env_page_ws_get_size(e) > newSize)
+		{
+			int32 next = e->__pws_fifo_next[i];
+			uint32 va = env_page_ws_get_virtual_address(e, i);
+			if (evictUsed || !(pt_get_page_permissions(e, va) & PERM_USED))
+				page_ws_evict_entry(e, i);
+			i = next;
+		}
+	}
+
+	// move the remaining pages to the new WS in their load order
+	struct WorkingSetElement *oldWS = e->ptr_pageWorkingSet;
+	void *oldIndex = e->__pws_free_bitmap;
+	int32 *oldFifoNext = e->__pws_fifo_next;
+	int32 oldest = env_page_ws_get_oldest_entry(e);
+
+	page_replacement_ws_resized(e);
+	unmap_user_page_WS(e);
+	e->ptr_pageWorkingSet = newWS;
+	e->page_WS_max_size = newSize;
+	env_page_ws_initialize(e, newIndex);
+
+	uint32 n = 0;
+	for (int32 i = oldest; i != -1; i = oldFifoNext[i], n++)
+	{
+		env_page_ws_set_entry(e, n, oldWS[i].virtual_address);
+		e->ptr_pageWorkingSet[n].time_stamp = oldWS[i].time_stamp;
+	}
+	e->page_last_WS_index = n % newSize;
+
+	e->page_WS_num_of_spare_entries = 0;
+	map_user_page_WS(e);
+	tlbflush();
+
+	kfree(oldWS);
+	free_user_page_WS_index(env_page_ws_index_size(oldSize), oldIndex);
+	return 0;
+}
+
 //
 // Initialize the kernel virtual memory layout for environment e.
 // Given a pointer to an allocated page directory, set the e->env_pgdir and e->env_cr3 accordingly,
@@ -558,12 +727,10 @@ void initialize_environment(struct Env *e, uint32 *ptr_user_page_directory, unsi
 #endif
 
 	// initialize environment working set
-	for (i = 0; i < (e->page_WS_max_size); i++)
-	{
-		e->ptr_pageWorkingSet[i].virtual_address = 0;
-		e->ptr_pageWorkingSet[i].empty = 1;
-		e->ptr_pageWorkingSet[i].time_stamp = 0;
-	}
+	void *ptr_WS_index = create_user_page_WS_index(e->page_WS_max_size);
+	if (ptr_WS_index == NULL)
+		panic("NOT ENOUGH KERNEL HEAP SPACE");
+	env_page_ws_initialize(e, ptr_WS_index);
 	e->page_last_WS_index = 0;
 
 	for (i = 0; i < __TWS_MAX_SIZE; i++)
@@ -584,6 +751,15 @@ void initialize_environment(struct Env *e, uint32 *ptr_user_page_directory, unsi
 	e->nModifiedPages = 0;
 	e->nNotModifiedPages = 0;
 
+	e->nARCHits = e->nARCGhostHitsB1 = e->nARCGhostHitsB2 = 0;
+	e->raLastFaultVA = e->raWindow = e->raLastNumOfPages = 0;
+	e->raStride = 0;
+	e->raNumOfPages = e->raNumOfHits = 0;
+
+	e->pffLastPageFaultsCounter = e->pffNumOfQuietQuanta = 0;
+	e->pffNumOfGrows = e->pffNumOfShrinks = 0;
+	e->lcLastPageFaultsCounter = e->nSwapOuts = 0;
+
 	e->nClocks = 0;
 	// e->shared_free_address = USER_SHARED_MEM_START;
 
@@ -609,26 +785,32 @@ static int program_segment_alloc_map_copy_workingset(struct Env *e, struct Progr
 	uint32 iVA = ROUNDDOWN((uint32)vaddr, PAGE_SIZE);
 	int r;
 	uint32 i = 0;
-	struct Frame_Info *p = NULL;
 
 	*allocated_pages = 0;
 	/*2015*/ // Load max of 6 pages only for the segment that start with va = 200000 [EXCEPT tpp]
 	if (iVA == 0x200000 && strcmp(e->prog_name, "tpp") != 0)
 		remaining_ws_pages = remaining_ws_pages < 6 ? remaining_ws_pages : 6;
 	/*==========================================================================================*/
-	for (; iVA < end_vaddr && i < remaining_ws_pages; i++, iVA += PAGE_SIZE)
+	// Allocate and map all the loaded pages of the segment at once
+	uint32 numOfPages = MIN((end_vaddr - iVA) / PAGE_SIZE, remaining_ws_pages);
+	struct Linked_List frames;
+	LIST_INIT(&frames);
+	if (allocate_frames(numOfPages, &frames) == E_NO_MEM)
+		panic("env_create: no enough memory to load the program segment at %x\n", iVA);
+	LOG_STRING("segment pages allocated");
+	if (map_frame_range(e->env_page_directory, &frames, (void *)iVA, numOfPages, PERM_USER | PERM_WRITEABLE) == E_NO_MEM)
 	{
-		// Allocate a page
-		allocate_frame(&p);
+		free_frames(&frames);
+		panic("env_create: no enough kernel heap space for the page tables of the program segment at %x\n", iVA);
+	}
+	LOG_STRING("segment pages mapped");
 
-		LOG_STRING("segment page allocated");
-		loadtime_map_frame(e->env_page_directory, p, (void *)iVA, PERM_USER | PERM_WRITEABLE);
-		LOG_STRING("segment page mapped");
+	for (; i < numOfPages; i++, iVA += PAGE_SIZE)
+	{
 
 		LOG_STATMENT(cprintf("Updating working set entry # %d", e->page_last_WS_index));
 
-		e->ptr_pageWorkingSet[e->page_last_WS_index].virtual_address = iVA;
-		e->ptr_pageWorkingSet[e->page_last_WS_index].empty = 0;
+		env_page_ws_set_entry(e, e->page_last_WS_index, iVA);
 		e->ptr_pageWorkingSet[e->page_last_WS_index].time_stamp = 0;
 
 		e->page_last_WS_index++;
@@ -821,11 +1003,14 @@ struct Env *env_create(char *user_program_name, unsigned int page_WS_size, unsig
 		uint32 start_last_page = ROUNDDOWN(seg_va + seg->size_in_file, PAGE_SIZE);
 		uint32 end_last_page = seg_va + seg->size_in_file;
 
-		for (i = end_first_page; i < start_last_page; i += PAGE_SIZE, src_ptr += PAGE_SIZE)
-		{
-			if (pf_add_env_page(e, i, src_ptr) == E_NO_PAGE_FILE_SPACE)
-				panic("ERROR: Page File OUT OF SPACE. can't load the program in Page file!!");
-		}
+		// they're written by one disk command per run of consecutive disk frames
+		uint32 numOfMiddlePages = (start_last_page > end_first_page) ? (start_last_page - end_first_page) / PAGE_SIZE : 0;
+		int ret = pf_add_env_pages(e, end_first_page, src_ptr, numOfMiddlePages);
+		if (ret == E_NO_PAGE_FILE_SPACE)
+			panic("ERROR: Page File OUT OF SPACE. can't load the program in Page file!!");
+		if (ret != 0)
+			panic("ERROR: can't write the program to the Page file!!");
+		src_ptr += numOfMiddlePages * PAGE_SIZE;
 		// LOG_STRING(" -------------------- PAGE FILE: 2nd page --> before last page are written");
 
 		///[3] temporary initialize last page in memory then writing it on page file
@@ -888,14 +1073,12 @@ struct Env *env_create(char *user_program_name, unsigned int page_WS_size, unsig
 	uint32 stackVa = USTACKTOP - PAGE_SIZE;
 	for (; stackVa >= ptr_user_stack_bottom; stackVa -= PAGE_SIZE)
 	{
+		// the new stack page should be initialized by 0's: take a pre-zeroed frame
 		struct Frame_Info *pp = NULL;
-		allocate_frame(&pp);
+		allocate_zeroed_frame(&pp);
 
 		loadtime_map_frame(e->env_page_directory, pp, (void *)stackVa, PERM_USER | PERM_WRITEABLE);
 
-		// initialize new page by 0's
-		memset((void *)stackVa, 0, PAGE_SIZE);
-
 		// now add it to the working set and the page table
 		{
 			env_page_ws_set_entry(e, e->page_last_WS_index, (uint32)stackVa);
@@ -47,6 +47,10 @@ void start_env_free(struct Env *e);
 void env_exit();
 
 // working set functions
+int env_page_ws_resize(struct Env *e, uint32 newSize);
+int env_page_ws_grow_quota(struct Env *e);
+void env_page_ws_shrink_quota(struct Env *e);
+void env_page_ws_trim(struct Env *e);
 
 ///===================================================================================
 
@@ -20,7 +20,7 @@ void scarce_memory()
 	if (((100 - memory_scarce_threshold_percentage) * number_of_frames) % 100 > 0)
 		total_size_tobe_allocated++;
 
-	uint32 size_of_already_allocated = number_of_frames - LIST_SIZE(&free_frame_list);
+	uint32 size_of_already_allocated = number_of_frames - calculate_free_frames();
 	uint32 size_tobe_allocated = total_size_tobe_allocated - size_of_already_allocated;
 	//	cprintf("size_of_already_allocated %d\n", size_of_already_allocated);
 	//	cprintf("size to be allocated %d\n", size_tobe_allocated);
@@ -0,0 +1,86 @@
+#include <inc/stdio.h>
+#include <kern/writeback.h>
+#include <kern/memory_manager.h>
+#include <kern/file_manager.h>
+
+void setWritebackWatermarks(uint32 high, uint32 low)
+{
+	_WritebackHighWatermark = high;
+	_WritebackLowWatermark = MIN(low, high);
+}
+uint32 getWritebackHighWatermark() { return _WritebackHighWatermark; }
+uint32 getWritebackLowWatermark() { return _WritebackLowWatermark; }
+
+// Write back the oldest pages of modified_frame_list until it has at most target pages, then move them
+// to free_frame_list: they stay buffered, so a fault on one of them still reclaims it without a disk read
+void writeback_modified_frames(uint32 target, uint8 background)
+{
+	if (LIST_SIZE(&modified_frame_list) <= target)
+		return;
+
+	struct Linked_List batch;
+	LIST_INIT(&batch);
+	while (LIST_SIZE(&modified_frame_list) > target)
+	{
+		struct Frame_Info *ptr_fi = LIST_FIRST(&modified_frame_list);
+		bufferlist_remove_page(&modified_frame_list, ptr_fi);
+		LIST_INSERT_TAIL(&batch, ptr_fi);
+	}
+	uint32 numOfPages = LIST_SIZE(&batch);
+
+	pf_update_modified_frames(&batch);
+
+	struct Frame_Info *ptr_fi;
+	LIST_FOREACH(ptr_fi, &batch)
+	{
+		pt_set_page_permissions(ptr_fi->environment, ptr_fi->va, 0, PERM_MODIFIED);
+		LIST_REMOVE(&batch, ptr_fi);
+		bufferList_add_page(&free_frame_list, ptr_fi);
+	}
+
+	if (background)
+		writebackNumOfBackgroundPages += numOfPages;
+	else
+		writebackNumOfForegroundPages += numOfPages;
+}
+
+// set from the tick the list reaches the high watermark till the one it's down to the low watermark
+static uint8 writebackOnClockActive;
+
+void writeback_on_clock()
+{
+	if (getWritebackHighWatermark() == 0)
+		return;
+	uint32 size = LIST_SIZE(&modified_frame_list);
+	if (size >= getWritebackHighWatermark())
+		writebackOnClockActive = 1;
+	if (!writebackOnClockActive)
+		return;
+
+	uint32 target = getWritebackLowWatermark();
+	if (size > target + WRITEBACK_MAX_PAGES_PER_TICK)
+		target = size - WRITEBACK_MAX_PAGES_PER_TICK;
+	writeback_modified_frames(target, 1);
+	if (LIST_SIZE(&modified_frame_list) <= getWritebackLowWatermark())
+		writebackOnClockActive = 0;
+}
+
+void writeback_on_idle()
+{
+	if (getWritebackHighWatermark() != 0)
+		writeback_modified_frames(getWritebackLowWatermark(), 1);
+}
+
+void writeback_print_statistics()
+{
+	if (getWritebackHighWatermark() == 0)
+		cprintf("Background write-back is disabled\n");
+	else
+		cprintf("Background write-back watermarks: high = %d, low = %d modified pages\n", getWritebackHighWatermark(), getWritebackLowWatermark());
+	cprintf("Modified pages = %d, cleaned in the background = %d, in the foreground = %d\n",
+			LIST_SIZE(&modified_frame_list), writebackNumOfBackgroundPages, writebackNumOfForegroundPages);
+	if (diskFlushStats.numOfFlushes > 0)
+		cprintf("Flushes = %d (%d pages, %d cycles/page), last one: %d pages in %d Kcycles\n",
+				diskFlushStats.numOfFlushes, diskFlushStats.numOfPages, (uint32)(diskFlushStats.totalCycles / diskFlushStats.numOfPages),
+				diskFlushStats.lastNumOfPages, (uint32)(diskFlushStats.lastCycles / 1000));
+}
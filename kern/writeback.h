@@ -0,0 +1,35 @@
+#ifndef FOS_KERN_WRITEBACK_H_
+#define FOS_KERN_WRITEBACK_H_
+
+#ifndef FOS_KERNEL
+#error "This is a FOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/memlayout.h>
+
+// Background write-back of the modified buffer: when modified_frame_list reaches the high watermark
+// (checked at each clock tick) or when the kernel is idle, its oldest pages are written back to the
+// page file and moved to free_frame_list (still buffered) until the list is down to the low watermark.
+// The page fault handler writes back the list by itself (foreground) only when it gets full.
+// A clock tick cleans at most WRITEBACK_MAX_PAGES_PER_TICK pages [one disk window] so that the env it
+// interrupts isn't stalled by a whole batch: the following ticks go on till the low watermark is reached.
+
+#define WRITEBACK_MAX_PAGES_PER_TICK KERNEL_DISK_WINDOW_PAGES
+
+uint32 _WritebackHighWatermark; // modified pages [0 = background write-back disabled]
+uint32 _WritebackLowWatermark;
+
+uint32 writebackNumOfBackgroundPages; // pages cleaned at a clock tick or while idle
+uint32 writebackNumOfForegroundPages; // pages cleaned by the page fault handler
+
+void setWritebackWatermarks(uint32 high, uint32 low);
+uint32 getWritebackHighWatermark();
+uint32 getWritebackLowWatermark();
+
+void writeback_modified_frames(uint32 target, uint8 background);
+void writeback_on_clock();
+void writeback_on_idle();
+void writeback_print_statistics();
+
+#endif // FOS_KERN_WRITEBACK_H_
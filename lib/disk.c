@@ -10,6 +10,7 @@
 #define IDE_BSY 0x80
 #define IDE_DRDY 0x40
 #define IDE_DF 0x20
+#define IDE_DRQ 0x08
 #define IDE_ERR 0x01
 
 static int diskno = 0;
@@ -33,17 +34,8 @@ int ide_read(uint32 secno, void *dst, uint32 nsecs)
 {
 	int r;
 
-	assert(nsecs <= 256);
-
 	// TODO: This BUSY-WAIT should be replaced by Interrupt to allow the OS to schedule another process till the device become ready [el7 :)]
-	ide_wait_ready(0);
-
-	outb(0x1F2, nsecs);
-	outb(0x1F3, secno & 0xFF);
-	outb(0x1F4, (secno >> 8) & 0xFF);
-	outb(0x1F5, (secno >> 16) & 0xFF);
-	outb(0x1F6, 0xE0 | ((diskno & 1) << 4) | ((secno >> 24) & 0x0F));
-	outb(0x1F7, 0x20); // CMD 0x20 means read sector
+	ide_start_command(secno, nsecs, 0x20); // CMD 0x20 means read sector
 
 	for (; nsecs > 0; nsecs--, dst += SECTSIZE)
 	{
@@ -60,18 +52,7 @@ int ide_write(uint32 secno, const void *src, uint32 nsecs)
 	int r;
 
 	// LOG_STATMENT(cprintf("1 ==> nsecs = %d\n",nsecs);)
-	assert(nsecs <= 256);
-
-	// LOG_STATMENT(cprintf("2\n");)
-	ide_wait_ready(0);
-
-	// LOG_STATMENT(cprintf("3 ==> nsecs = %d\n",nsecs);)
-	outb(0x1F2, nsecs);
-	outb(0x1F3, secno & 0xFF);
-	outb(0x1F4, (secno >> 8) & 0xFF);
-	outb(0x1F5, (secno >> 16) & 0xFF);
-	outb(0x1F6, 0xE0 | ((diskno & 1) << 4) | ((secno >> 24) & 0x0F));
-	outb(0x1F7, 0x30); // CMD 0x30 means write sector
+	ide_start_command(secno, nsecs, 0x30); // CMD 0x30 means write sector
 
 	for (; nsecs > 0; nsecs--, src += SECTSIZE)
 	{
@@ -91,3 +72,100 @@ int ide_write(uint32 secno, const void *src, uint32 nsecs)
 
 	return 0;
 }
+
+// Enable/disable the disk interrupt [IRQ14] through the nIEN bit of the device control register
+void ide_enable_interrupts(bool enable)
+{
+	outb(0x3F6, enable ? 0 : 0x02);
+}
+
+// The 48-bit LBA version of the given read/write command
+static uint8 ide_command_lba48(uint8 command)
+{
+	switch (command)
+	{
+	case 0x20:
+		return 0x24; // READ SECTORS EXT
+	case 0x30:
+		return 0x34; // WRITE SECTORS EXT
+	case 0xC8:
+		return 0x25; // READ DMA EXT
+	case 0xCA:
+		return 0x35; // WRITE DMA EXT
+	}
+	panic("ide_command_lba48: no 48-bit LBA version of command %x", command);
+	return 0;
+}
+
+// Issue the given read/write command on nsecs sectors from secno without waiting for its data. The commands on
+// more than 256 sectors [or beyond the 28-bit LBA range] are issued by their 48-bit LBA versions
+void ide_start_command(uint32 secno, uint32 nsecs, uint8 command)
+{
+	assert(nsecs > 0 && nsecs <= IDE_MAX_SECTORS);
+
+	ide_wait_ready(0);
+
+	if (nsecs <= 256 && secno + nsecs <= (1 << 28))
+	{
+		outb(0x1F2, nsecs); // 0 means 256
+		outb(0x1F3, secno & 0xFF);
+		outb(0x1F4, (secno >> 8) & 0xFF);
+		outb(0x1F5, (secno >> 16) & 0xFF);
+		outb(0x1F6, 0xE0 | ((diskno & 1) << 4) | ((secno >> 24) & 0x0F));
+		outb(0x1F7, command);
+		return;
+	}
+
+	// the high bytes of the count and LBA first, then the low ones [0 sectors means 65536]
+	outb(0x1F6, 0x40 | ((diskno & 1) << 4));
+	outb(0x1F2, (nsecs >> 8) & 0xFF);
+	outb(0x1F3, (secno >> 24) & 0xFF);
+	outb(0x1F4, 0);
+	outb(0x1F5, 0);
+	outb(0x1F2, nsecs & 0xFF);
+	outb(0x1F3, secno & 0xFF);
+	outb(0x1F4, (secno >> 8) & 0xFF);
+	outb(0x1F5, (secno >> 16) & 0xFF);
+	outb(0x1F7, ide_command_lba48(command));
+}
+
+// Start reading nsecs sectors from secno without waiting for them: the disk interrupts when each
+// sector is ready to be taken by ide_read_sector()
+int ide_start_read(uint32 secno, uint32 nsecs)
+{
+	ide_start_command(secno, nsecs, 0x20); // CMD 0x20 means read sector
+	return 0;
+}
+
+// Check the status of the disk at the end of a command [e.g. a DMA one]. It also acknowledges its interrupt
+int ide_end_command(void)
+{
+	int r = inb(0x1F7);
+
+	if (r & (IDE_DF | IDE_ERR))
+	{
+		LOG_STATMENT(cprintf("ERROR @ ide_end_command() = %x(%d)\n", r, r););
+		return -1;
+	}
+	return 0;
+}
+
+// Take the next sector of the read started by ide_start_read() into dst if the disk has it ready.
+// Return 1 if it's not ready yet. Reading the status also acknowledges the disk interrupt
+int ide_read_sector(void *dst)
+{
+	int r = inb(0x1F7);
+
+	if (r & IDE_BSY)
+		return 1;
+	if (r & (IDE_DF | IDE_ERR))
+	{
+		LOG_STATMENT(cprintf("ERROR @ ide_read_sector() = %x(%d)\n", r, r););
+		return -1;
+	}
+	if (!(r & IDE_DRQ))
+		return 1;
+
+	insl(0x1F0, dst, SECTSIZE / 4);
+	return 0;
+}
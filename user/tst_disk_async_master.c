@@ -0,0 +1,41 @@
+// tests two environments faulting on page-file reads at the same time
+/* *********************************************************** */
+/* RUN "diskasync 1" FIRST so the faulting envs block on the disk interrupt,
+ * then "diskasync" again to see how many reads were completed by it */
+/* *********************************************************** */
+
+#include <inc/lib.h>
+
+#define NUM_OF_SLAVES 2
+
+void _main(void)
+{
+	rsttst();
+
+	/*[1] RUN THE SLAVES: each one pages its array out and back in*/
+
+	//****************************************************************************************************************
+	// IMP: program name is placed statically on the stack to avoid PAGE FAULT on it during the sys call inside the Kernel
+	char slaveProgName[16] = "tdiskasyncslave";
+	//****************************************************************************************************************
+
+	int32 envIds[NUM_OF_SLAVES];
+	for (int i = 0; i < NUM_OF_SLAVES; ++i)
+	{
+		envIds[i] = sys_create_env(slaveProgName, (myEnv->page_WS_max_size), (myEnv->percentage_of_WS_pages_to_be_removed));
+		if (envIds[i] == E_ENV_CREATION_ERROR)
+			panic("can't create the slave program");
+	}
+	for (int i = 0; i < NUM_OF_SLAVES; ++i)
+		sys_run_env(envIds[i]);
+
+	/*[2] WAIT TILL BOTH OF THEM FINISH*/
+	for (int i = 0; i < 100 && gettst() != NUM_OF_SLAVES; ++i)
+		env_sleep(100);
+
+	if (gettst() != NUM_OF_SLAVES)
+		panic("the slaves didn't finish: a page-file read was lost or returned to the wrong env");
+
+	cprintf("Congratulations!! test of concurrent page-file reads completed successfully.\n");
+	return;
+}
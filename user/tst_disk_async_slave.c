@@ -0,0 +1,29 @@
+// Slave program of tdiskasync: fill an array larger than the WS, then read it back from the page file
+#include <inc/lib.h>
+
+#define NUM_OF_PAGES 64
+
+/*SHOULD be on User DATA not on the STACK*/
+char arr[PAGE_SIZE * NUM_OF_PAGES];
+
+void _main(void)
+{
+	int32 envID = sys_getenvid();
+
+	/*[1] WRITE EACH PAGE: the WS is much smaller, so most of them are paged out*/
+	for (int i = 0; i < NUM_OF_PAGES; ++i)
+	{
+		arr[i * PAGE_SIZE] = (char)(envID + i);
+		arr[i * PAGE_SIZE + PAGE_SIZE - 1] = (char)(envID - i);
+	}
+
+	/*[2] READ THEM BACK: each fault is a page-file read that overlaps the other slave's*/
+	for (int i = 0; i < NUM_OF_PAGES; ++i)
+	{
+		if (arr[i * PAGE_SIZE] != (char)(envID + i) || arr[i * PAGE_SIZE + PAGE_SIZE - 1] != (char)(envID - i))
+			panic("page %d read back from the page file is wrong", i);
+	}
+
+	inctst();
+	return;
+}